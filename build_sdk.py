@@ -508,6 +508,7 @@ EXAMPLES = {
     "passive_server": Path("example/passive_server"),
     "hierarchy": Path("example/hierarchy"),
     "timer": Path("example/timer"),
+    "printf": Path("example/printf"),
 }
 
 
@@ -808,7 +809,8 @@ def build_lib_component(
     build_dir: Path,
     board: BoardInfo,
     config: ConfigInfo,
-    llvm: bool
+    llvm: bool,
+    defines: List[Tuple[str, str]],
 ) -> None:
     """Build a specific library component.
 
@@ -819,7 +821,8 @@ def build_lib_component(
     build_dir.mkdir(exist_ok=True, parents=True)
 
     target_triple = f"{board.arch.target_triple()}"
-    defines_str = f" ARCH={board.arch.to_str()} BUILD_DIR={build_dir.absolute()} SEL4_SDK={sel4_dir.absolute()} TARGET_TRIPLE={target_triple} LLVM={llvm}"
+    defines_str = " ".join(f"{k}={v}" for k, v in defines)
+    defines_str += f" ARCH={board.arch.to_str()} BUILD_DIR={build_dir.absolute()} SEL4_SDK={sel4_dir.absolute()} TARGET_TRIPLE={target_triple} LLVM={llvm}"
 
     if board.gcc_cpu is not None:
         defines_str += f" GCC_CPU={board.gcc_cpu}"
@@ -924,6 +927,9 @@ def main() -> None:
     parser.add_argument("--llvm", action="store_true", help="Cross-compile seL4 and Microkit's run-time targets with LLVM")
     parser.add_argument("--boards", metavar="BOARDS", help="Comma-separated list of boards to support. When absent, all boards are supported.")
     parser.add_argument("--configs", metavar="CONFIGS", help="Comma-separated list of configurations to support. When absent, all configurations are supported.")
+    parser.add_argument("--loader-cached-copy", action="store_true", help="Loader copies its regions with the MMU and data caches enabled (AArch64 only)")
+    parser.add_argument("--loader-parallel-copy", action="store_true", help="Loader starts secondary CPUs first and copies its regions on all active CPUs")
+    parser.add_argument("--libmicrokit-instrument", action="store_true", help="Build libmicrokit with handler instrumentation")
     parser.add_argument("--skip-tool", action="store_true", help="Tool will not be built")
     parser.add_argument("--skip-run-time", action="store_true", help="Run-time targets will not be built")
     parser.add_argument("--skip-sel4", action="store_true", help="seL4 will not be built")
@@ -1047,10 +1053,17 @@ def main() -> None:
                 loader_defines = []
                 if not board.arch.is_x86():
                     loader_defines.append(("LINK_ADDRESS", hex(board.loader_link_address)))
+                    if args.loader_cached_copy:
+                        loader_defines.append(("CACHED_COPY", "True"))
+                    if args.loader_parallel_copy:
+                        loader_defines.append(("PARALLEL_COPY", "True"))
                     build_elf_component("loader", sdk_dir, build_dir, board, config, args.llvm, loader_defines)
 
                 build_elf_component("monitor", sdk_dir, build_dir, board, config, args.llvm, [])
-                build_lib_component("libmicrokit", sdk_dir, build_dir, board, config, args.llvm)
+                libmicrokit_defines = []
+                if args.libmicrokit_instrument:
+                    libmicrokit_defines.append(("INSTRUMENT", "True"))
+                build_lib_component("libmicrokit", sdk_dir, build_dir, board, config, args.llvm, libmicrokit_defines)
                 if not args.skip_initialiser:
                     build_initialiser("initialiser", sdk_dir, build_dir, board, config)
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+#include <microkit.h>
+
+#define SLOW_SERVER_CH 0
+#define FAST_SERVER_CH 1
+
+#define WARMUP_ITERATIONS 100
+#define ITERATIONS 10000
+
+static inline uint64_t cycles(void)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    uint64_t c;
+    asm volatile("isb; mrs %0, pmccntr_el0" : "=r"(c));
+    return c;
+#elif defined(CONFIG_ARCH_RISCV)
+    uint64_t c;
+    asm volatile("rdcycle %0" : "=r"(c));
+    return c;
+#elif defined(CONFIG_ARCH_X86_64)
+    uint32_t lo, hi;
+    asm volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+#error "Unsupported architecture"
+#endif
+}
+
+static seL4_Word slow_ppcall(seL4_Word arg)
+{
+    for (seL4_Uint8 i = 0; i < MICROKIT_FAST_MRS; i++) {
+        microkit_mr_set(i, arg);
+    }
+    microkit_ppcall(SLOW_SERVER_CH, microkit_msginfo_new(0, MICROKIT_FAST_MRS));
+
+    return microkit_mr_get(0);
+}
+
+static seL4_Word fast_ppcall(seL4_Word arg)
+{
+    seL4_Word mr0 = arg, mr1 = arg, mr2 = arg, mr3 = arg;
+    microkit_ppcall_regs4(FAST_SERVER_CH, microkit_msginfo_new(0, MICROKIT_FAST_MRS), &mr0, &mr1, &mr2, &mr3);
+
+    return mr0;
+}
+
+static void benchmark(const char *name, seL4_Word (*ppcall)(seL4_Word))
+{
+    seL4_Word value = 0;
+    for (int i = 0; i < WARMUP_ITERATIONS; i++) {
+        value = ppcall(value);
+    }
+
+    uint64_t start = cycles();
+    for (int i = 0; i < ITERATIONS; i++) {
+        value = ppcall(value);
+    }
+    uint64_t end = cycles();
+
+    if (value != WARMUP_ITERATIONS + ITERATIONS) {
+        microkit_dbg_puts("CLIENT|ERROR: unexpected result from server\n");
+    }
+
+    microkit_dbg_puts("CLIENT|INFO: ");
+    microkit_dbg_puts(name);
+    microkit_dbg_puts(": ");
+    microkit_dbg_put32((end - start) / ITERATIONS);
+    microkit_dbg_puts(" cycles per round-trip\n");
+}
+
+void init(void)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    /* Enable and reset the cycle counter, this requires the PMU to be exported to user-space */
+    asm volatile("msr pmcr_el0, %0" :: "r"((seL4_Word)((1 << 0) | (1 << 2))));
+    asm volatile("msr pmcntenset_el0, %0" :: "r"((seL4_Word)(1ULL << 31)));
+#endif
+
+    benchmark("microkit_ppcall", slow_ppcall);
+    benchmark("microkit_ppcall_regs4", fast_ppcall);
+}
+
+void notified(microkit_channel ch)
+{
+    microkit_dbg_puts("CLIENT|ERROR: received a notification on an unexpected channel\n");
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <microkit.h>
+
+/* Adds one to each argument, without touching the IPC buffer */
+microkit_msginfo protected_fast(microkit_channel ch, microkit_msginfo msginfo, seL4_Word mrs[MICROKIT_FAST_MRS])
+{
+    for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+        mrs[i] += 1;
+    }
+
+    return microkit_msginfo_new(0, MICROKIT_FAST_MRS);
+}
+
+void init(void)
+{
+}
+
+void notified(microkit_channel ch)
+{
+    microkit_dbg_puts("FAST_SERVER|ERROR: received a notification on an unexpected channel\n");
+}
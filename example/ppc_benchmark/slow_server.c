@@ -0,0 +1,26 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <microkit.h>
+
+/* Adds one to each argument, passing everything through the IPC buffer */
+microkit_msginfo protected(microkit_channel ch, microkit_msginfo msginfo)
+{
+    for (seL4_Uint8 i = 0; i < MICROKIT_FAST_MRS; i++) {
+        microkit_mr_set(i, microkit_mr_get(i) + 1);
+    }
+
+    return microkit_msginfo_new(0, MICROKIT_FAST_MRS);
+}
+
+void init(void)
+{
+}
+
+void notified(microkit_channel ch)
+{
+    microkit_dbg_puts("SLOW_SERVER|ERROR: received a notification on an unexpected channel\n");
+}
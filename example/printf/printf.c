@@ -0,0 +1,114 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <stdint.h>
+#include <microkit.h>
+
+static int failures;
+
+static int streq(const char *a, const char *b)
+{
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+#define CHECK(expected, ...) check(__LINE__, expected, microkit_snprintf(buf, sizeof(buf), __VA_ARGS__))
+
+static char buf[64];
+
+static void check(int line, const char *expected, int len)
+{
+    int expected_len = 0;
+    while (expected[expected_len]) {
+        expected_len++;
+    }
+
+    if (!streq(buf, expected) || len != expected_len) {
+        microkit_printf("printf: line %d: expected \"%s\", got \"%s\" (length %d)\n", line, expected, buf, len);
+        failures++;
+    }
+}
+
+void init(void)
+{
+    /* Precision is the minimum number of digits, and zero with a precision of zero has none */
+    CHECK("", "%.0d", 0);
+    CHECK("", "%.0u", 0u);
+    CHECK("", "%.0x", 0u);
+    CHECK("", "%.0o", 0u);
+    CHECK("[  ]", "[%2.0d]", 0);
+    CHECK("[]", "[%.d]", 0);
+    CHECK("7", "%.0d", 7);
+    CHECK("0", "%d", 0);
+    CHECK("0", "%.1d", 0);
+    CHECK("00042", "%.5d", 42);
+    CHECK("-00042", "%.5d", -42);
+    CHECK("  00042", "%7.5d", 42);
+    CHECK("00ff", "%.4x", 0xff);
+    CHECK("0", "%.*d", -1, 0);
+
+    /* Precision limits the length of strings */
+    CHECK("hel", "%.3s", "hello");
+    CHECK("", "%.0s", "hello");
+    CHECK("  hel", "%5.3s", "hello");
+
+    /* Width and flags */
+    CHECK("00042", "%05d", 42);
+    CHECK("42   |", "%-5d|", 42);
+    CHECK("-0042", "%05d", -42);
+    CHECK("   ab", "%*s", 5, "ab");
+    CHECK("ab   |", "%*s|", -5, "ab");
+    CHECK("+1|-1|+0", "%+d|%+d|%+d", 1, -1, 0);
+    CHECK(" 2|-2", "% d|% d", 2, -2);
+    CHECK("  +42", "%+5d", 42);
+    CHECK("+0042", "%+05d", 42);
+    CHECK("0x1f|0X1F|0", "%#x|%#X|%#x", 0x1fu, 0x1fu, 0u);
+    CHECK("0x001f", "%#06x", 0x1fu);
+    CHECK("017|0|00017", "%#o|%#.0o|%#.5o", 017u, 0u, 017u);
+    CHECK("+1| 2|0x3|ok", "%+d|% d|%#x|%s", 1, 2, 3, "ok");
+
+    /* Conversions and length modifiers */
+    CHECK("-9223372036854775808", "%lld", (long long)(-9223372036854775807ll - 1));
+    CHECK("18446744073709551615", "%llu", 18446744073709551615ull);
+    CHECK("DEADBEEF", "%X", 0xdeadbeefu);
+    CHECK("777", "%o", 0777u);
+    CHECK("-1", "%hhd", 255);
+    CHECK("65535", "%hu", 0xffffffffu);
+    CHECK("-5|ok", "%jd|%s", (intmax_t)-5, "ok");
+    CHECK("x%", "%c%%", 'x');
+    CHECK("0x0", "%p", (void *)0);
+
+    /* Unsupported floating point conversions still consume their argument */
+    CHECK("%f|%Lg|ok", "%f|%Lg|%s", 1.5, (long double)2.5, "ok");
+
+    /* %n stores the number of characters output so far */
+    int count = 0;
+    CHECK("abc|ok", "abc%n|%s", &count, "ok");
+    if (count != 3) {
+        microkit_printf("printf: %%n: expected 3, got %d\n", count);
+        failures++;
+    }
+
+    /* Output is truncated to the buffer, the return value is the full length */
+    char small[4];
+    int len = microkit_snprintf(small, sizeof(small), "%d", 123456);
+    if (len != 6 || !streq(small, "123")) {
+        microkit_printf("printf: truncation: expected \"123\" (length 6), got \"%s\" (length %d)\n", small, len);
+        failures++;
+    }
+
+    if (failures == 0) {
+        microkit_dbg_puts("printf: all checks passed\n");
+    } else {
+        microkit_printf("printf: %d checks failed\n", failures);
+    }
+}
+
+void notified(microkit_channel ch)
+{
+}
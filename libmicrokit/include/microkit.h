@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <stdarg.h>
 #include <sel4/sel4.h>
 #ifdef CONFIG_VTX
 #include <sel4/arch/vmenter.h>
@@ -19,6 +20,8 @@ typedef unsigned int microkit_child;
 typedef unsigned int microkit_ioport;
 typedef seL4_MessageInfo_t microkit_msginfo;
 
+/* The PD's own VSpace, used for cache maintenance on ARM */
+#define VSPACE_CAP 3
 #define MONITOR_EP 5
 /* Only valid in the 'benchmark' configuration */
 #define TCB_CAP 6
@@ -32,6 +35,9 @@ typedef seL4_MessageInfo_t microkit_msginfo;
 #define BASE_VCPU_CAP 330
 #define BASE_IOPORT_CAP 394
 #define BASE_USER_CAPS 458
+/* Only valid in PDs with channel groups. This should be kept in sync with
+ * `PD_BASE_GROUP_OUTPUT_NOTIFICATION_CAP` in capdl/builder.rs */
+#define BASE_GROUP_OUTPUT_NOTIFICATION_CAP 512
 
 /* This should be kept in sync with `PD_ROOT_CAP_BITS` in capdl/builder.rs */
 #define PD_ROOT_CAP_BITS 6
@@ -41,19 +47,53 @@ typedef seL4_MessageInfo_t microkit_msginfo;
 #define MICROKIT_MAX_CHANNELS 62
 #define MICROKIT_MAX_CHANNEL_ID (MICROKIT_MAX_CHANNELS - 1)
 #define MICROKIT_MAX_IOPORT_ID MICROKIT_MAX_CHANNELS
+/* PDs with channel groups can also use these channel IDs for notifications. This
+ * should be kept in sync with `CHANNEL_GROUP_MIN_ID` and friends in sdf.rs */
+#define MICROKIT_CHANNEL_GROUP_BASE 64
+#define MICROKIT_MAX_CHANNEL_GROUPS 16
+#define MICROKIT_MAX_GROUP_CHANNEL_ID (MICROKIT_CHANNEL_GROUP_BASE + MICROKIT_MAX_CHANNEL_GROUPS * 64 - 1)
+/* Channel whose badge bit indicates that channel group IDs are pending */
+#define MICROKIT_CHANNEL_GROUP_CHANNEL MICROKIT_MAX_CHANNEL_ID
 #define MICROKIT_PD_NAME_LENGTH 64
+#define MICROKIT_MAX_DEFERRED_SIGNALS 8
+/* Number of message registers that are passed in CPU registers rather than the IPC buffer */
+#define MICROKIT_FAST_MRS 4
+/* Used to keep data written by different PDs on separate cache lines */
+#define MICROKIT_CACHE_LINE_SIZE 64
 
 /* User provided functions */
 void init(void);
 void notified(microkit_channel ch);
+/* Optional, receives all pending channels of a wake-up at once, see the manual */
+void notified_batch(seL4_Word pending);
 microkit_msginfo protected(microkit_channel ch, microkit_msginfo msginfo);
+/* Optional, receives the first message registers directly instead of via the IPC buffer */
+microkit_msginfo protected_fast(microkit_channel ch, microkit_msginfo msginfo, seL4_Word mrs[MICROKIT_FAST_MRS]);
 seL4_Bool fault(microkit_child child, microkit_msginfo msginfo, microkit_msginfo *reply_msginfo);
+/* Optional, called by the event loop right before it blocks and right after it wakes up */
+void microkit_before_block(void);
+void microkit_after_wake(void);
 
 extern char microkit_name[MICROKIT_PD_NAME_LENGTH];
-/* These next three variables are so our PDs can combine a signal with the next Recv syscall */
+/* These next variables are so our PDs can combine signals with the next Recv syscall */
+struct microkit_deferred_signal {
+    seL4_CPtr cap;
+    seL4_MessageInfo_t msg;
+};
+extern struct microkit_deferred_signal microkit_deferred_signals[MICROKIT_MAX_DEFERRED_SIGNALS];
+extern seL4_Word microkit_deferred_signals_count;
+/* Number of system calls avoided by deferring signals, for performance analysis */
+extern seL4_Word microkit_deferred_syscalls_saved;
+/* Deprecated single deferred signal, kept for PDs that set it directly. If set when the
+ * event loop is about to wait, it is added to the deferred signals above and cleared. */
 extern seL4_Bool microkit_have_signal;
 extern seL4_CPtr microkit_signal_cap;
 extern seL4_MessageInfo_t microkit_signal_msg;
+/* Number of times the event loop polls before blocking, patched by the Microkit tool,
+ * and how often polling found an event versus the event loop having to block. */
+extern seL4_Word microkit_poll_budget;
+extern seL4_Word microkit_poll_hits;
+extern seL4_Word microkit_poll_blocks;
 #if defined(CONFIG_VTX)
 struct microkit_x86_vcpu_state {
     seL4_Bool is_on;
@@ -70,12 +110,97 @@ extern seL4_Word microkit_irqs;
 extern seL4_Word microkit_notifications;
 extern seL4_Word microkit_pps;
 extern seL4_Word microkit_ioports;
+/* Channels with notification coalescing enabled and, for each of them, the address
+ * of the flags page shared with the other end. The lowest bit of the address
+ * indicates which of the two flags belongs to this PD. */
+extern seL4_Word microkit_coalesced;
+extern seL4_Word microkit_coalesce_flags[MICROKIT_MAX_CHANNELS];
+/* Number of notifications that did not need a signal due to coalescing */
+extern seL4_Word microkit_signals_coalesced;
+/* Address and size of the PPC buffer for each channel that has one, zero otherwise */
+extern seL4_Word microkit_pp_buffers[MICROKIT_MAX_CHANNELS];
+extern seL4_Word microkit_pp_buffer_sizes[MICROKIT_MAX_CHANNELS];
+
+/* Channel groups bitmap of this PD, patched by the Microkit tool. NULL if the PD
+ * does not have channel groups. */
+extern struct microkit_channel_groups *microkit_channel_groups;
+/* Channel group IDs of this PD that can notify, one bit per ID */
+extern seL4_Word microkit_group_notifications[MICROKIT_MAX_CHANNEL_GROUPS];
+/* For channels where the other end uses a channel group ID, the address of the
+ * other end's bitmap, with the index of the ID in the lower bits. */
+extern seL4_Word microkit_group_targets[MICROKIT_MAX_CHANNELS];
+
+/* Two-level bitmap of the pending channel group IDs of a PD. Senders set the bit of
+ * the ID in 'pending' and then the bit of its group in 'summary'. */
+struct microkit_channel_groups {
+    seL4_Word summary __attribute__((aligned(MICROKIT_CACHE_LINE_SIZE)));
+    seL4_Word pending[MICROKIT_MAX_CHANNEL_GROUPS] __attribute__((aligned(MICROKIT_CACHE_LINE_SIZE)));
+};
+
+/* Each end of a coalesced channel owns one flag in the shared flags page. It is
+ * zero while the PD needs to be signalled and non-zero once a signal is pending. */
+struct microkit_coalesce_flag {
+    seL4_Word pending;
+} __attribute__((aligned(MICROKIT_CACHE_LINE_SIZE)));
 
 /*
- * Output a single character on the debug console.
+ * Handler instrumentation. When libmicrokit is built with instrumentation enabled
+ * (MICROKIT_INSTRUMENT defined) the event loop
+ * records the cycles spent in each entry point into a region that the Microkit tool
+ * creates for PDs with an <instrumentation> element. Bucket 'i' of a histogram counts
+ * the invocations that took between 4^i and 4^(i+1) cycles, the last bucket also
+ * counts everything above it.
+ */
+#define MICROKIT_INSTRUMENT_BUCKETS 16
+/* This should be kept in sync with `PD_INSTRUMENTATION_SIZE` in sdf.rs */
+#define MICROKIT_INSTRUMENTATION_SIZE 0x7000
+
+struct microkit_instrument_histogram {
+    seL4_Word count;
+    seL4_Word total_cycles;
+    seL4_Word max_cycles;
+    seL4_Word buckets[MICROKIT_INSTRUMENT_BUCKETS];
+};
+
+struct microkit_instrumentation {
+    struct microkit_instrument_histogram notified[MICROKIT_MAX_CHANNELS];
+    struct microkit_instrument_histogram protected[MICROKIT_MAX_CHANNELS];
+    /* Indexed by the child that faulted */
+    struct microkit_instrument_histogram fault[MICROKIT_MAX_CHANNELS];
+    /* Whole wake-ups due to notifications, including all 'notified' calls */
+    struct microkit_instrument_histogram notified_batch;
+};
+
+/* Address of this PD's instrumentation region, patched by the Microkit tool.
+ * NULL when the PD has no <instrumentation> element. */
+extern struct microkit_instrumentation *microkit_instrumentation;
+
+/* For PDs that are the producer of a ring with log="true", the ring that debug output
+ * is written to instead of the console, patched by the Microkit tool. */
+extern seL4_Word microkit_log_ring;
+extern seL4_Word microkit_log_ring_size;
+extern seL4_Word microkit_log_ch;
+/* Number of log records dropped because the log ring was full */
+extern seL4_Word microkit_log_dropped;
+
+/* Debug output is written to the log ring in records of up to one line */
+#define MICROKIT_LOG_RECORD_SIZE 64
+
+struct microkit_log_record {
+    seL4_Uint8 len;
+    char data[MICROKIT_LOG_RECORD_SIZE - 1];
+};
+
+/*
+ * Output a single character on the debug console, or the log ring if the PD has one.
  */
 void microkit_dbg_putc(int c);
 
+/*
+ * Write any incomplete line of debug output to the log ring.
+ */
+void microkit_dbg_flush(void);
+
 /*
  * Output a NUL terminated string to the debug console.
  */
@@ -91,6 +216,23 @@ void microkit_dbg_put8(seL4_Uint8 x);
  */
 void microkit_dbg_put32(seL4_Uint32 x);
 
+/*
+ * Formatted output to the debug console. Supports the conversions d, i, u, x, X,
+ * o, p, s, c, n and % with flags, width, precision and length modifiers but no
+ * floating point. Returns the number of characters written.
+ */
+int microkit_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int microkit_vprintf(const char *fmt, va_list ap) __attribute__((format(printf, 1, 0)));
+
+/*
+ * Formatted output to `buf`, writing at most `size` bytes including the NUL
+ * terminator. Returns the length the output would have had without truncation.
+ */
+int microkit_snprintf(char *buf, seL4_Word size, const char *fmt, ...)
+__attribute__((format(printf, 3, 4)));
+int microkit_vsnprintf(char *buf, seL4_Word size, const char *fmt, va_list ap)
+__attribute__((format(printf, 3, 0)));
+
 static inline void microkit_internal_crash(seL4_Error err)
 {
     /*
@@ -104,8 +246,73 @@ static inline void microkit_internal_crash(seL4_Error err)
     *x = 0;
 }
 
+static inline struct microkit_coalesce_flag *microkit_internal_coalesce_flag(microkit_channel ch, seL4_Bool peer)
+{
+    seL4_Word flags = microkit_coalesce_flags[ch];
+    struct microkit_coalesce_flag *base = (struct microkit_coalesce_flag *)(flags & ~1ULL);
+    return &base[(flags & 1) ^ peer];
+}
+
+/*
+ * For a coalesced channel, returns whether the peer needs to be signalled. Only the
+ * first notification since the peer was last woken up on this channel does.
+ */
+static inline seL4_Bool microkit_internal_coalesce_should_signal(microkit_channel ch)
+{
+    if ((microkit_coalesced & (1ULL << ch)) == 0) {
+        return seL4_True;
+    }
+
+    /* Make any writes to shared memory visible before we look at the peer's flag */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&microkit_internal_coalesce_flag(ch, seL4_True)->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        return seL4_True;
+    }
+
+    microkit_signals_coalesced++;
+    return seL4_False;
+}
+
+static inline seL4_Bool microkit_internal_group_id_valid(microkit_channel ch)
+{
+    if (ch < MICROKIT_CHANNEL_GROUP_BASE || ch > MICROKIT_MAX_GROUP_CHANNEL_ID) {
+        return seL4_False;
+    }
+    seL4_Word idx = ch - MICROKIT_CHANNEL_GROUP_BASE;
+    return (microkit_group_notifications[idx / 64] & (1ULL << (idx % 64))) != 0;
+}
+
+/*
+ * For a channel where the other end uses a channel group ID, marks the ID as pending
+ * and returns whether the other end needs to be signalled. Only the first notification
+ * in a group since the other end last looked at the group does.
+ */
+static inline seL4_Bool microkit_internal_group_should_signal(microkit_channel ch)
+{
+    seL4_Word target = microkit_group_targets[ch];
+    if (target == 0) {
+        return seL4_True;
+    }
+
+    seL4_Word idx_mask = (1ULL << seL4_PageBits) - 1;
+    struct microkit_channel_groups *groups = (struct microkit_channel_groups *)(target & ~idx_mask);
+    seL4_Word idx = target & idx_mask;
+    seL4_Word group_bit = 1ULL << (idx / 64);
+    __atomic_fetch_or(&groups->pending[idx / 64], 1ULL << (idx % 64), __ATOMIC_SEQ_CST);
+    if ((__atomic_fetch_or(&groups->summary, group_bit, __ATOMIC_SEQ_CST) & group_bit) == 0) {
+        return seL4_True;
+    }
+
+    microkit_signals_coalesced++;
+    return seL4_False;
+}
+
 static inline void microkit_notify(microkit_channel ch)
 {
+    if (microkit_internal_group_id_valid(ch)) {
+        seL4_Signal(BASE_GROUP_OUTPUT_NOTIFICATION_CAP + ch - MICROKIT_CHANNEL_GROUP_BASE);
+        return;
+    }
     if (ch > MICROKIT_MAX_CHANNEL_ID || (microkit_notifications & (1ULL << ch)) == 0) {
         microkit_dbg_puts(microkit_name);
         microkit_dbg_puts(" microkit_notify: invalid channel given '");
@@ -113,6 +320,9 @@ static inline void microkit_notify(microkit_channel ch)
         microkit_dbg_puts("'\n");
         return;
     }
+    if (!microkit_internal_coalesce_should_signal(ch) || !microkit_internal_group_should_signal(ch)) {
+        return;
+    }
     seL4_Signal(BASE_OUTPUT_NOTIFICATION_CAP + ch);
 }
 
@@ -175,6 +385,121 @@ static inline microkit_msginfo microkit_ppcall(microkit_channel ch, microkit_msg
     return seL4_Call(BASE_ENDPOINT_CAP + ch, msginfo);
 }
 
+/*
+ * Variants of `microkit_ppcall` where the arguments and return values are passed
+ * in CPU registers and never go through the IPC buffer. Each pointer is used as the
+ * argument for the corresponding message register if the message length covers it,
+ * and is overwritten with the corresponding message register of the reply.
+ */
+static inline microkit_msginfo microkit_ppcall_regs4(microkit_channel ch, microkit_msginfo msginfo, seL4_Word *mr0,
+                                                     seL4_Word *mr1, seL4_Word *mr2, seL4_Word *mr3)
+{
+    if (ch > MICROKIT_MAX_CHANNEL_ID || (microkit_pps & (1ULL << ch)) == 0) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ppcall_regs: invalid channel given '");
+        microkit_dbg_put32(ch);
+        microkit_dbg_puts("'\n");
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+    return seL4_CallWithMRs(BASE_ENDPOINT_CAP + ch, msginfo, mr0, mr1, mr2, mr3);
+}
+
+static inline microkit_msginfo microkit_ppcall_regs3(microkit_channel ch, microkit_msginfo msginfo, seL4_Word *mr0,
+                                                     seL4_Word *mr1, seL4_Word *mr2)
+{
+    return microkit_ppcall_regs4(ch, msginfo, mr0, mr1, mr2, seL4_Null);
+}
+
+static inline microkit_msginfo microkit_ppcall_regs2(microkit_channel ch, microkit_msginfo msginfo, seL4_Word *mr0,
+                                                     seL4_Word *mr1)
+{
+    return microkit_ppcall_regs4(ch, msginfo, mr0, mr1, seL4_Null, seL4_Null);
+}
+
+static inline microkit_msginfo microkit_ppcall_regs1(microkit_channel ch, microkit_msginfo msginfo, seL4_Word *mr0)
+{
+    return microkit_ppcall_regs4(ch, msginfo, mr0, seL4_Null, seL4_Null, seL4_Null);
+}
+
+/*
+ * Returns the PPC buffer of the given channel, or NULL if it does not have one.
+ */
+static inline void *microkit_ppc_buf(microkit_channel ch)
+{
+    if (ch > MICROKIT_MAX_CHANNEL_ID) {
+        return seL4_Null;
+    }
+    return (void *)microkit_pp_buffers[ch];
+}
+
+static inline seL4_Word microkit_ppc_buf_size(microkit_channel ch)
+{
+    if (ch > MICROKIT_MAX_CHANNEL_ID) {
+        return 0;
+    }
+    return microkit_pp_buffer_sizes[ch];
+}
+
+/*
+ * Perform a PPC where the request is the first 'len' bytes of the channel's PPC
+ * buffer. The length is passed in the first message register and the length of
+ * the reply is returned in 'reply_len', the reply itself is left in the buffer.
+ */
+static inline microkit_msginfo microkit_ppcall_buf(microkit_channel ch, seL4_Word label, seL4_Word len,
+                                                   seL4_Word *reply_len)
+{
+    if (ch > MICROKIT_MAX_CHANNEL_ID || (microkit_pps & (1ULL << ch)) == 0 || microkit_pp_buffers[ch] == 0) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ppcall_buf: invalid channel given '");
+        microkit_dbg_put32(ch);
+        microkit_dbg_puts("'\n");
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+    if (len > microkit_pp_buffer_sizes[ch]) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ppcall_buf: length exceeds the PPC buffer of channel '");
+        microkit_dbg_put32(ch);
+        microkit_dbg_puts("'\n");
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+
+    seL4_Word mr0 = len;
+    microkit_msginfo reply = seL4_CallWithMRs(BASE_ENDPOINT_CAP + ch, seL4_MessageInfo_new(label, 0, 0, 1), &mr0,
+                                              seL4_Null, seL4_Null, seL4_Null);
+    if (reply_len != seL4_Null) {
+        seL4_Word buf_len = seL4_MessageInfo_get_length(reply) > 0 ? mr0 : 0;
+        *reply_len = buf_len > microkit_pp_buffer_sizes[ch] ? microkit_pp_buffer_sizes[ch] : buf_len;
+    }
+
+    return reply;
+}
+
+/*
+ * Used in 'protected' to reply with the first 'len' bytes of the channel's PPC
+ * buffer, the result should be returned from 'protected'. The length of the
+ * request is in the first message register.
+ */
+static inline microkit_msginfo microkit_ppc_reply_buf(microkit_channel ch, seL4_Word label, seL4_Word len)
+{
+    if (ch > MICROKIT_MAX_CHANNEL_ID || microkit_pp_buffers[ch] == 0) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ppc_reply_buf: invalid channel given '");
+        microkit_dbg_put32(ch);
+        microkit_dbg_puts("'\n");
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+    if (len > microkit_pp_buffer_sizes[ch]) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ppc_reply_buf: length exceeds the PPC buffer of channel '");
+        microkit_dbg_put32(ch);
+        microkit_dbg_puts("'\n");
+        return seL4_MessageInfo_new(0, 0, 0, 0);
+    }
+
+    seL4_SetMR(0, len);
+    return seL4_MessageInfo_new(label, 0, 0, 1);
+}
+
 static inline microkit_msginfo microkit_msginfo_new(seL4_Word label, seL4_Uint16 count)
 {
     return seL4_MessageInfo_new(label, 0, 0, count);
@@ -288,6 +613,88 @@ static inline void microkit_arm_smc_call(seL4_ARM_SMCContext *args, seL4_ARM_SMC
 }
 #endif /* CONFIG_ALLOW_SMC_CALLS */
 
+/*
+ * Cache maintenance of the virtual address range [start, end), for memory shared
+ * with devices that do not snoop the caches. On AArch64 cleaning is done with
+ * cache instructions from user level, which seL4 permits, but invalidation is
+ * only allowed in the kernel and is done with the PD's VSpace capability, one
+ * invocation per page. x86-64 has coherent DMA so only a memory barrier is needed.
+ *
+ * Not all supported RISC-V platforms have coherent DMA (for example the JH7110 on
+ * the Star64), and there is no cache maintenance that user level can rely on, so
+ * these are not provided there. Calling them is a build error rather than silently
+ * leaving stale data in the caches.
+ */
+#if defined(CONFIG_ARCH_RISCV)
+#define MICROKIT_INTERNAL_CACHE_UNSUPPORTED \
+    __attribute__((error("cache maintenance is not supported by libmicrokit on RISC-V")))
+
+void microkit_cache_clean_range(seL4_Word start, seL4_Word end) MICROKIT_INTERNAL_CACHE_UNSUPPORTED;
+void microkit_cache_clean_invalidate_range(seL4_Word start, seL4_Word end) MICROKIT_INTERNAL_CACHE_UNSUPPORTED;
+void microkit_cache_invalidate_range(seL4_Word start, seL4_Word end) MICROKIT_INTERNAL_CACHE_UNSUPPORTED;
+#else
+#if defined(CONFIG_ARCH_AARCH64)
+static inline seL4_Word microkit_internal_dcache_line_size(void)
+{
+    seL4_Word ctr;
+    asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+    /* DminLine is log2 of the number of words in the smallest data cache line */
+    return 4 << ((ctr >> 16) & 0xf);
+}
+#endif
+
+static inline void microkit_cache_clean_range(seL4_Word start, seL4_Word end)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    seL4_Word line = microkit_internal_dcache_line_size();
+    for (seL4_Word addr = start & ~(line - 1); addr < end; addr += line) {
+        asm volatile("dc cvac, %0" :: "r"(addr) : "memory");
+    }
+    asm volatile("dsb sy" ::: "memory");
+#elif defined(CONFIG_ARCH_X86_64)
+    asm volatile("mfence" ::: "memory");
+#else
+#error "Unsupported architecture for 'microkit_cache_clean_range'"
+#endif
+}
+
+static inline void microkit_cache_clean_invalidate_range(seL4_Word start, seL4_Word end)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    seL4_Word line = microkit_internal_dcache_line_size();
+    for (seL4_Word addr = start & ~(line - 1); addr < end; addr += line) {
+        asm volatile("dc civac, %0" :: "r"(addr) : "memory");
+    }
+    asm volatile("dsb sy" ::: "memory");
+#elif defined(CONFIG_ARCH_X86_64)
+    asm volatile("mfence" ::: "memory");
+#else
+#error "Unsupported architecture for 'microkit_cache_clean_invalidate_range'"
+#endif
+}
+
+static inline void microkit_cache_invalidate_range(seL4_Word start, seL4_Word end)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    /* The kernel only operates on ranges within a single page */
+    while (start < end) {
+        seL4_Word page_end = (start | ((1ULL << seL4_PageBits) - 1)) + 1;
+        seL4_Word chunk_end = page_end < end ? page_end : end;
+        seL4_Error err = seL4_ARM_VSpace_Invalidate_Data(VSPACE_CAP, start, chunk_end);
+        if (err != seL4_NoError) {
+            microkit_dbg_puts("microkit_cache_invalidate_range: error invalidating range\n");
+            microkit_internal_crash(err);
+        }
+        start = chunk_end;
+    }
+#elif defined(CONFIG_ARCH_X86_64)
+    asm volatile("mfence" ::: "memory");
+#else
+#error "Unsupported architecture for 'microkit_cache_invalidate_range'"
+#endif
+}
+#endif /* CONFIG_ARCH_RISCV */
+
 #if defined(CONFIG_ARCH_X86_64)
 static inline void microkit_x86_ioport_write_8(microkit_ioport ioport_id, seL4_Word port_addr, seL4_Word data)
 {
@@ -561,8 +968,41 @@ static inline void microkit_vcpu_x86_off(void)
 #endif /* CONFIG_VTX */
 #endif /* CONFIG_ARCH_X86_64 */
 
+static inline void microkit_internal_deferred_flush(void)
+{
+    for (seL4_Word i = 0; i < microkit_deferred_signals_count; i++) {
+        seL4_Send(microkit_deferred_signals[i].cap, microkit_deferred_signals[i].msg);
+    }
+    microkit_deferred_signals_count = 0;
+}
+
+static inline void microkit_internal_deferred_signal(seL4_CPtr cap, seL4_MessageInfo_t msg)
+{
+    for (seL4_Word i = 0; i < microkit_deferred_signals_count; i++) {
+        /* Signalling the same object again before it has been sent is a no-op */
+        if (microkit_deferred_signals[i].cap == cap) {
+            microkit_deferred_syscalls_saved++;
+            return;
+        }
+    }
+
+    /* Send everything in the order it was deferred if we have run out of space */
+    if (microkit_deferred_signals_count == MICROKIT_MAX_DEFERRED_SIGNALS) {
+        microkit_internal_deferred_flush();
+    }
+
+    microkit_deferred_signals[microkit_deferred_signals_count].cap = cap;
+    microkit_deferred_signals[microkit_deferred_signals_count].msg = msg;
+    microkit_deferred_signals_count++;
+}
+
 static inline void microkit_deferred_notify(microkit_channel ch)
 {
+    if (microkit_internal_group_id_valid(ch)) {
+        microkit_internal_deferred_signal(BASE_GROUP_OUTPUT_NOTIFICATION_CAP + ch - MICROKIT_CHANNEL_GROUP_BASE,
+                                          seL4_MessageInfo_new(0, 0, 0, 0));
+        return;
+    }
     if (ch > MICROKIT_MAX_CHANNEL_ID || (microkit_notifications & (1ULL << ch)) == 0) {
         microkit_dbg_puts(microkit_name);
         microkit_dbg_puts(" microkit_deferred_notify: invalid channel given '");
@@ -570,9 +1010,10 @@ static inline void microkit_deferred_notify(microkit_channel ch)
         microkit_dbg_puts("'\n");
         return;
     }
-    microkit_have_signal = seL4_True;
-    microkit_signal_msg = seL4_MessageInfo_new(0, 0, 0, 0);
-    microkit_signal_cap = (BASE_OUTPUT_NOTIFICATION_CAP + ch);
+    if (!microkit_internal_coalesce_should_signal(ch) || !microkit_internal_group_should_signal(ch)) {
+        return;
+    }
+    microkit_internal_deferred_signal(BASE_OUTPUT_NOTIFICATION_CAP + ch, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
 static inline void microkit_deferred_irq_ack(microkit_channel ch)
@@ -584,9 +1025,190 @@ static inline void microkit_deferred_irq_ack(microkit_channel ch)
         microkit_dbg_puts("'\n");
         return;
     }
-    microkit_have_signal = seL4_True;
-    microkit_signal_msg = seL4_MessageInfo_new(IRQAckIRQ, 0, 0, 0);
-    microkit_signal_cap = (BASE_IRQ_CAP + ch);
+    microkit_internal_deferred_signal(BASE_IRQ_CAP + ch, seL4_MessageInfo_new(IRQAckIRQ, 0, 0, 0));
+}
+
+/*
+ * Single-producer/single-consumer ring buffer, shared between two PDs via a
+ * 'ring' element in the system description.
+ *
+ * The start of the shared memory holds the producer and consumer indices, each
+ * in their own cache line, followed by the entries. Indices are free running and
+ * only ever written by one side. The number of entries is the largest power of
+ * two that fits in the memory region, so both sides will agree on the layout as
+ * long as they pass the same entry size to `microkit_ring_init`.
+ */
+struct microkit_ring_shared {
+    /* Written by the producer only */
+    seL4_Word head __attribute__((aligned(MICROKIT_CACHE_LINE_SIZE)));
+    /* Written by the consumer only */
+    seL4_Word tail __attribute__((aligned(MICROKIT_CACHE_LINE_SIZE)));
+};
+
+/* Local (non-shared) state for one end of a ring */
+struct microkit_ring {
+    struct microkit_ring_shared *shared;
+    unsigned char *entries;
+    seL4_Word entry_size;
+    seL4_Word capacity;
+    microkit_channel ch;
+};
+
+static inline seL4_Bool microkit_ring_init(struct microkit_ring *ring, void *vaddr, seL4_Word size,
+                                           seL4_Word entry_size, microkit_channel ch)
+{
+    seL4_Word capacity = 0;
+    if (entry_size != 0 && size > sizeof(struct microkit_ring_shared)) {
+        capacity = (size - sizeof(struct microkit_ring_shared)) / entry_size;
+    }
+    if (capacity == 0) {
+        microkit_dbg_puts(microkit_name);
+        microkit_dbg_puts(" microkit_ring_init: ring is too small for entry size '");
+        microkit_dbg_put32(entry_size);
+        microkit_dbg_puts("'\n");
+        return seL4_False;
+    }
+
+    /* Round down to a power of two so indices can be masked */
+    while (capacity & (capacity - 1)) {
+        capacity &= capacity - 1;
+    }
+
+    ring->shared = vaddr;
+    ring->entries = (unsigned char *)vaddr + sizeof(struct microkit_ring_shared);
+    ring->entry_size = entry_size;
+    ring->capacity = capacity;
+    ring->ch = ch;
+
+    return seL4_True;
+}
+
+static inline void *microkit_ring_entry(struct microkit_ring *ring, seL4_Word idx)
+{
+    return ring->entries + (idx & (ring->capacity - 1)) * ring->entry_size;
+}
+
+/*
+ * Producer: returns the number of entries that can be written contiguously,
+ * starting at the entry pointed to by 'entries'.
+ */
+static inline seL4_Word microkit_ring_reserve(struct microkit_ring *ring, void **entries)
+{
+    seL4_Word head = ring->shared->head;
+    seL4_Word tail = __atomic_load_n(&ring->shared->tail, __ATOMIC_ACQUIRE);
+    seL4_Word free = ring->capacity - (head - tail);
+    seL4_Word until_wrap = ring->capacity - (head & (ring->capacity - 1));
+
+    *entries = microkit_ring_entry(ring, head);
+    return free < until_wrap ? free : until_wrap;
+}
+
+/*
+ * Producer: publish 'count' entries previously written via `microkit_ring_reserve`.
+ * The consumer is only notified if it may have seen the ring as empty.
+ */
+static inline void microkit_ring_commit(struct microkit_ring *ring, seL4_Word count)
+{
+    seL4_Word head = ring->shared->head;
+    __atomic_store_n(&ring->shared->head, head + count, __ATOMIC_RELEASE);
+    /* Order the head store before the tail load, pairs with `microkit_ring_release` */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->shared->tail, __ATOMIC_RELAXED) == head) {
+        microkit_notify(ring->ch);
+    }
+}
+
+/*
+ * Consumer: returns the number of entries that can be read contiguously,
+ * starting at the entry pointed to by 'entries'.
+ */
+static inline seL4_Word microkit_ring_peek(struct microkit_ring *ring, void **entries)
+{
+    seL4_Word tail = ring->shared->tail;
+    seL4_Word head = __atomic_load_n(&ring->shared->head, __ATOMIC_ACQUIRE);
+    seL4_Word used = head - tail;
+    seL4_Word until_wrap = ring->capacity - (tail & (ring->capacity - 1));
+
+    *entries = microkit_ring_entry(ring, tail);
+    return used < until_wrap ? used : until_wrap;
+}
+
+/*
+ * Consumer: hand 'count' entries previously read via `microkit_ring_peek` back to
+ * the producer. The producer is only notified if it may have seen the ring as full.
+ * The consumer must call `microkit_ring_peek` again after releasing entries, as
+ * the producer will not notify it for entries committed in the meantime.
+ */
+static inline void microkit_ring_release(struct microkit_ring *ring, seL4_Word count)
+{
+    seL4_Word tail = ring->shared->tail;
+    __atomic_store_n(&ring->shared->tail, tail + count, __ATOMIC_RELEASE);
+    /* Order the tail store before the head load, pairs with `microkit_ring_commit` */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->shared->head, __ATOMIC_RELAXED) - tail == ring->capacity) {
+        microkit_notify(ring->ch);
+    }
+}
+
+/* Bounds of the PD's heap, patched by the Microkit tool. Zero if the PD has no heap. */
+extern seL4_Word microkit_heap_base;
+extern seL4_Word microkit_heap_size;
+
+/* All heap and arena allocations are aligned to this */
+#define MICROKIT_HEAP_ALIGN 16
+/* Allocations up to this size come from per size-class free lists */
+#define MICROKIT_HEAP_MAX_CLASS_SIZE 2048
+
+/*
+ * Allocate `size` bytes from the PD's heap. Returns NULL if the heap is exhausted.
+ * Small allocations are rounded up to a power of two and reuse freed blocks of
+ * the same size, larger ones are carved from the end of the used part of the heap.
+ */
+void *microkit_heap_alloc(seL4_Word size);
+
+/*
+ * Free an allocation made with `microkit_heap_alloc`, `size` must be the size
+ * that was allocated. Large allocations are only returned to the heap if they
+ * were the most recent large allocation.
+ */
+void microkit_heap_free(void *ptr, seL4_Word size);
+
+/*
+ * An arena is a block of the heap that is allocated from by bumping a pointer
+ * and freed all at once.
+ */
+struct microkit_arena {
+    seL4_Word base;
+    seL4_Word top;
+    seL4_Word end;
+};
+
+/*
+ * Initialise `arena` with `size` bytes taken from the PD's heap. Returns
+ * seL4_False if there is not enough space left in the heap.
+ */
+seL4_Bool microkit_arena_init(struct microkit_arena *arena, seL4_Word size);
+
+/*
+ * Allocate `size` bytes aligned to `align`, which must be a power of two, from
+ * `arena`. Returns NULL if the arena is exhausted.
+ */
+static inline void *microkit_arena_alloc(struct microkit_arena *arena, seL4_Word size, seL4_Word align)
+{
+    seL4_Word start = (arena->top + align - 1) & ~(align - 1);
+    if (start < arena->top || start > arena->end || size > arena->end - start) {
+        return seL4_Null;
+    }
+    arena->top = start + size;
+    return (void *)start;
+}
+
+/*
+ * Free every allocation made from `arena`.
+ */
+static inline void microkit_arena_reset(struct microkit_arena *arena)
+{
+    arena->top = arena->base;
 }
 
 /**
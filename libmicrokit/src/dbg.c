@@ -9,15 +9,64 @@
 
 extern char microkit_name[];
 
+static struct microkit_ring log_ring;
+static struct microkit_log_record log_record;
+/* Once set, output goes straight to the console, for example for crash output */
+static seL4_Bool log_direct;
+
+static seL4_Bool log_enabled(void)
+{
+    if (microkit_log_ring == 0 || log_direct) {
+        return seL4_False;
+    }
+
+    if (log_ring.shared == seL4_Null) {
+        /* Any error from initialising the ring goes to the console */
+        log_direct = seL4_True;
+        if (!microkit_ring_init(&log_ring, (void *)microkit_log_ring, microkit_log_ring_size,
+                                sizeof(struct microkit_log_record), microkit_log_ch)) {
+            return seL4_False;
+        }
+        log_direct = seL4_False;
+    }
+
+    return seL4_True;
+}
+
+void microkit_dbg_flush(void)
+{
+    if (log_record.len == 0) {
+        return;
+    }
+
+    struct microkit_log_record *entry;
+    if (microkit_ring_reserve(&log_ring, (void **)&entry) == 0) {
+        microkit_log_dropped++;
+    } else {
+        entry->len = log_record.len;
+        for (seL4_Word i = 0; i < log_record.len; i++) {
+            entry->data[i] = log_record.data[i];
+        }
+        microkit_ring_commit(&log_ring, 1);
+    }
+    log_record.len = 0;
+}
+
 void microkit_dbg_putc(int c)
 {
+    if (log_enabled()) {
+        log_record.data[log_record.len++] = c;
+        if (c == '\n' || log_record.len == sizeof(log_record.data)) {
+            microkit_dbg_flush();
+        }
+        return;
+    }
+
 #if defined(CONFIG_PRINTING)
     seL4_DebugPutChar(c);
 #endif
 }
 
-
-
 void microkit_dbg_puts(const char *s)
 {
     while (*s) {
@@ -58,6 +107,9 @@ void microkit_dbg_put32(seL4_Uint32 x)
  */
 __attribute__((weak)) void __assert_fail(const char  *str, const char *file, int line, const char *function)
 {
+    /* We are about to crash, so do not rely on the log ring being drained */
+    microkit_dbg_flush();
+    log_direct = seL4_True;
     microkit_dbg_puts(microkit_name);
     microkit_dbg_puts("|assert failed: ");
     microkit_dbg_puts(str);
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <microkit.h>
+
+/*
+ * The heap is only used by the PD's single thread, so no locking is needed.
+ * Small allocations are served from free lists of power of two size classes
+ * and otherwise by bumping a pointer through the heap, so that each allocation
+ * and free takes a constant, small amount of time.
+ */
+
+#define CLASS_MIN_BITS 4
+#define CLASS_MAX_BITS 11
+#define CLASS_COUNT (CLASS_MAX_BITS - CLASS_MIN_BITS + 1)
+
+_Static_assert((1 << CLASS_MIN_BITS) == MICROKIT_HEAP_ALIGN, "smallest size class must match heap alignment");
+_Static_assert((1 << CLASS_MAX_BITS) == MICROKIT_HEAP_MAX_CLASS_SIZE, "largest size class must match maximum class size");
+
+struct free_block {
+    struct free_block *next;
+};
+
+static struct free_block *free_lists[CLASS_COUNT];
+/* Start of the unused part of the heap, zero until the heap is first used */
+static seL4_Word heap_top;
+
+static inline unsigned size_class(seL4_Word size)
+{
+    if (size <= (1 << CLASS_MIN_BITS)) {
+        return 0;
+    }
+    /* Bits needed to represent size - 1, i.e. log2 of size rounded up */
+    unsigned bits = seL4_WordBits - __builtin_clzl(size - 1);
+    return bits - CLASS_MIN_BITS;
+}
+
+static void *heap_bump(seL4_Word size)
+{
+    if (heap_top == 0) {
+        heap_top = microkit_heap_base;
+    }
+
+    seL4_Word end = microkit_heap_base + microkit_heap_size;
+    if (size > end - heap_top) {
+        return seL4_Null;
+    }
+
+    void *ptr = (void *)heap_top;
+    heap_top += size;
+    return ptr;
+}
+
+static inline seL4_Word round_up(seL4_Word size)
+{
+    return (size + MICROKIT_HEAP_ALIGN - 1) & ~(seL4_Word)(MICROKIT_HEAP_ALIGN - 1);
+}
+
+void *microkit_heap_alloc(seL4_Word size)
+{
+    if (size == 0 || size > microkit_heap_size) {
+        return seL4_Null;
+    }
+
+    if (size > MICROKIT_HEAP_MAX_CLASS_SIZE) {
+        return heap_bump(round_up(size));
+    }
+
+    unsigned class = size_class(size);
+    struct free_block *block = free_lists[class];
+    if (block != seL4_Null) {
+        free_lists[class] = block->next;
+        return block;
+    }
+
+    return heap_bump((seL4_Word)1 << (class + CLASS_MIN_BITS));
+}
+
+void microkit_heap_free(void *ptr, seL4_Word size)
+{
+    if (ptr == seL4_Null) {
+        return;
+    }
+
+    if (size > MICROKIT_HEAP_MAX_CLASS_SIZE) {
+        if ((seL4_Word)ptr + round_up(size) == heap_top) {
+            heap_top = (seL4_Word)ptr;
+        }
+        return;
+    }
+
+    unsigned class = size_class(size);
+    struct free_block *block = ptr;
+    block->next = free_lists[class];
+    free_lists[class] = block;
+}
+
+seL4_Bool microkit_arena_init(struct microkit_arena *arena, seL4_Word size)
+{
+    void *base = heap_bump(round_up(size));
+    if (base == seL4_Null) {
+        return seL4_False;
+    }
+
+    arena->base = (seL4_Word)base;
+    arena->top = arena->base;
+    arena->end = arena->base + size;
+    return seL4_True;
+}
@@ -26,9 +26,15 @@ bool microkit_passive;
 char microkit_name[MICROKIT_PD_NAME_LENGTH];
 /* We use seL4 typedefs as this variable is exposed to the libmicrokit header
  * and we do not want to rely on compiler built-in defines. */
+struct microkit_deferred_signal microkit_deferred_signals[MICROKIT_MAX_DEFERRED_SIGNALS];
+seL4_Word microkit_deferred_signals_count;
+seL4_Word microkit_deferred_syscalls_saved;
 seL4_Bool microkit_have_signal = seL4_False;
 seL4_CPtr microkit_signal_cap;
 seL4_MessageInfo_t microkit_signal_msg;
+seL4_Word microkit_poll_budget;
+seL4_Word microkit_poll_hits;
+seL4_Word microkit_poll_blocks;
 
 #if defined(CONFIG_VTX)
 struct microkit_x86_vcpu_state microkit_x86_vcpu_state;
@@ -38,6 +44,21 @@ seL4_Word microkit_irqs;
 seL4_Word microkit_notifications;
 seL4_Word microkit_pps;
 seL4_Word microkit_ioports;
+seL4_Word microkit_coalesced;
+seL4_Word microkit_coalesce_flags[MICROKIT_MAX_CHANNELS];
+seL4_Word microkit_signals_coalesced;
+struct microkit_channel_groups *microkit_channel_groups;
+seL4_Word microkit_group_notifications[MICROKIT_MAX_CHANNEL_GROUPS];
+seL4_Word microkit_group_targets[MICROKIT_MAX_CHANNELS];
+seL4_Word microkit_pp_buffers[MICROKIT_MAX_CHANNELS];
+seL4_Word microkit_pp_buffer_sizes[MICROKIT_MAX_CHANNELS];
+struct microkit_instrumentation *microkit_instrumentation;
+seL4_Word microkit_log_ring;
+seL4_Word microkit_log_ring_size;
+seL4_Word microkit_log_ch;
+seL4_Word microkit_log_dropped;
+seL4_Word microkit_heap_base;
+seL4_Word microkit_heap_size;
 
 #define BIT(n) (1ULL << (n))
 #define MASK(n) (BIT(n) - 1ULL)
@@ -46,10 +67,104 @@ seL4_Word microkit_ioports;
 seL4_IPCBuffer *__sel4_ipc_buffer = (seL4_IPCBuffer *)(seL4_UserVSpaceTop & ~MASK(seL4_PageBits));
 _Static_assert(sizeof(seL4_IPCBuffer) <= BIT(seL4_PageBits),
                "IPC Buffer is expected to need less than one page in size");
+_Static_assert(MICROKIT_FAST_MRS == seL4_FastMessageRegisters,
+               "The event loop expects to receive all fast message registers");
+
+#if defined(MICROKIT_INSTRUMENT)
+_Static_assert(sizeof(struct microkit_instrumentation) <= MICROKIT_INSTRUMENTATION_SIZE,
+               "Instrumentation is expected to fit in the region created by the tool");
+
+static inline seL4_Word instrument_cycles(void)
+{
+    seL4_Word cycles;
+#if defined(CONFIG_ARCH_AARCH64)
+    asm volatile("isb; mrs %0, pmccntr_el0" : "=r"(cycles));
+#elif defined(CONFIG_ARCH_RISCV)
+    asm volatile("rdcycle %0" : "=r"(cycles));
+#elif defined(CONFIG_ARCH_X86_64)
+    seL4_Word lo, hi;
+    asm volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    cycles = (hi << 32) | lo;
+#endif
+    return cycles;
+}
+
+static void instrument_init(void)
+{
+#if defined(CONFIG_ARCH_AARCH64)
+    /* Enable the cycle counter, this requires the PMU to be exported to user-space */
+    if (microkit_instrumentation != NULL) {
+        seL4_Word pmcr;
+        asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+        asm volatile("msr pmcr_el0, %0" :: "r"(pmcr | 1));
+        asm volatile("msr pmcntenset_el0, %0" :: "r"((seL4_Word)(1ULL << 31)));
+    }
+#endif
+}
+
+static void instrument_record(struct microkit_instrument_histogram *histogram, seL4_Word start)
+{
+    seL4_Word cycles = instrument_cycles() - start;
+    seL4_Word bucket = cycles == 0 ? 0 : (63 - __builtin_clzll(cycles)) / 2;
+    if (bucket >= MICROKIT_INSTRUMENT_BUCKETS) {
+        bucket = MICROKIT_INSTRUMENT_BUCKETS - 1;
+    }
+
+    histogram->count++;
+    histogram->total_cycles += cycles;
+    if (cycles > histogram->max_cycles) {
+        histogram->max_cycles = cycles;
+    }
+    histogram->buckets[bucket]++;
+}
+
+/* PDs without an instrumentation region do not touch the cycle counter */
+#define INSTRUMENT_BEGIN(start) seL4_Word start = microkit_instrumentation != NULL ? instrument_cycles() : 0
+#define INSTRUMENT_END(start, histogram) do {                                  \
+    if (microkit_instrumentation != NULL) {                                     \
+        instrument_record(&microkit_instrumentation->histogram, start);         \
+    }                                                                           \
+} while (0)
+#else
+static void instrument_init(void) {}
+#define INSTRUMENT_BEGIN(start)
+#define INSTRUMENT_END(start, histogram)
+#endif /* MICROKIT_INSTRUMENT */
+
+/*
+ * The event loop hooks are weak references rather than weak definitions, so a PD
+ * that does not provide them only pays for a comparison.
+ */
+extern void microkit_before_block(void) __attribute__((weak));
+extern void microkit_after_wake(void) __attribute__((weak));
 
 extern const void (*const __init_array_start [])(void);
 extern const void (*const __init_array_end [])(void);
 
+__attribute__((weak)) void notified(microkit_channel ch)
+{
+    microkit_dbg_puts(microkit_name);
+    microkit_dbg_puts(" is missing the 'notified' entry point\n");
+    microkit_internal_crash(0);
+}
+
+/*
+ * Default batch handler, a PD that overrides this receives every channel that
+ * was pending when it was woken up in a single call. Otherwise we dispatch each
+ * set bit to 'notified' in ascending channel order.
+ */
+__attribute__((weak)) void notified_batch(seL4_Word pending)
+{
+    while (pending != 0) {
+        microkit_channel ch = __builtin_ctzll(pending);
+        INSTRUMENT_BEGIN(start);
+        notified(ch);
+        INSTRUMENT_END(start, notified[ch]);
+        /* Clear the lowest set bit */
+        pending &= pending - 1;
+    }
+}
+
 __attribute__((weak)) microkit_msginfo protected(microkit_channel ch, microkit_msginfo msginfo)
 {
     microkit_dbg_puts(microkit_name);
@@ -58,6 +173,25 @@ __attribute__((weak)) microkit_msginfo protected(microkit_channel ch, microkit_m
     return seL4_MessageInfo_new(0, 0, 0, 0);
 }
 
+/*
+ * Default fast handler, a PD that overrides this gets the first message registers
+ * of the PPC in 'mrs' and returns the first message registers of the reply in it.
+ * Otherwise they are transferred through the IPC buffer and 'protected' is called.
+ */
+__attribute__((weak)) microkit_msginfo protected_fast(microkit_channel ch, microkit_msginfo msginfo,
+                                                      seL4_Word mrs[MICROKIT_FAST_MRS])
+{
+    for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+        seL4_SetMR(i, mrs[i]);
+    }
+    microkit_msginfo reply = protected(ch, msginfo);
+    for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+        mrs[i] = seL4_GetMR(i);
+    }
+
+    return reply;
+}
+
 __attribute__((weak)) seL4_Bool fault(microkit_child child, microkit_msginfo msginfo, microkit_msginfo *reply_msginfo)
 {
     microkit_dbg_puts(microkit_name);
@@ -66,19 +200,34 @@ __attribute__((weak)) seL4_Bool fault(microkit_child child, microkit_msginfo msg
     return seL4_False;
 }
 
-static void run_init_funcs(void)
+/*
+ * Dispatch every pending channel group ID to 'notified'. The summary is cleared
+ * before the groups so that a sender that finds its group already marked in the
+ * summary can rely on us seeing its ID without a signal.
+ *
+ * Group IDs do not fit in the bitmask passed to 'notified_batch' or in the per-channel
+ * instrumentation histograms, so unlike other channels they always go to 'notified'
+ * and are only recorded as part of the whole wake-up. This is documented in the manual.
+ */
+static void channel_groups_dispatch(void)
 {
-    size_t count = __init_array_end - __init_array_start;
-    for (size_t i = 0; i < count; i++) {
-        __init_array_start[i]();
+    seL4_Word summary = __atomic_exchange_n(&microkit_channel_groups->summary, 0, __ATOMIC_SEQ_CST);
+    while (summary != 0) {
+        seL4_Word group = __builtin_ctzll(summary);
+        seL4_Word pending = __atomic_exchange_n(&microkit_channel_groups->pending[group], 0, __ATOMIC_SEQ_CST);
+        while (pending != 0) {
+            notified(MICROKIT_CHANNEL_GROUP_BASE + group * 64 + __builtin_ctzll(pending));
+            pending &= pending - 1;
+        }
+        summary &= summary - 1;
     }
 }
 
-static void deferred_flush(void)
+static void run_init_funcs(void)
 {
-    if (microkit_have_signal) {
-        seL4_Send(microkit_signal_cap, microkit_signal_msg);
-        microkit_have_signal = seL4_False;
+    size_t count = __init_array_end - __init_array_start;
+    for (size_t i = 0; i < count; i++) {
+        __init_array_start[i]();
     }
 }
 
@@ -88,7 +237,7 @@ static seL4_MessageInfo_t x86_vcpu_resume(seL4_Word *badge)
     /* There is no seL4 invocation which combines a VMEnter and a non-blocking send.
      * Thus, we must perform any deferred signals from `microkit_deferred_notify()` /
      * `microkit_deferred_irq_ack()` before invoking VMEnter. */
-    deferred_flush();
+    microkit_internal_deferred_flush();
 
     seL4_Word is_fault, fault_reason;
     struct microkit_x86_vcpu_state *s = &microkit_x86_vcpu_state;
@@ -121,10 +270,34 @@ static seL4_MessageInfo_t x86_vcpu_resume(seL4_Word *badge)
 }
 #endif
 
+/*
+ * Poll the input cap up to 'microkit_poll_budget' times before blocking on it. Any
+ * deferred signals are sent first as they cannot be combined with a non-blocking receive.
+ */
+static seL4_MessageInfo_t recv_polling(seL4_Word *badge, seL4_Word mrs[MICROKIT_FAST_MRS])
+{
+    microkit_internal_deferred_flush();
+
+    for (seL4_Word i = 0; i < microkit_poll_budget; i++) {
+        seL4_MessageInfo_t tag = seL4_NBRecvWithMRs(INPUT_CAP, badge, &mrs[0], &mrs[1], &mrs[2], &mrs[3], REPLY_CAP);
+        /* Every event has a non-zero badge */
+        if (*badge != 0) {
+            microkit_poll_hits++;
+            return tag;
+        }
+    }
+
+    microkit_poll_blocks++;
+    return seL4_RecvWithMRs(INPUT_CAP, badge, &mrs[0], &mrs[1], &mrs[2], &mrs[3], REPLY_CAP);
+}
+
 static void handler_loop(void)
 {
     bool have_reply = false;
     seL4_MessageInfo_t reply_tag = seL4_MessageInfo_new(0, 0, 0, 0);
+    /* The fast message registers are kept in CPU registers across the event loop
+     * and only written to the IPC buffer when a handler needs them there. */
+    seL4_Word mrs[MICROKIT_FAST_MRS] = {0};
 
     /**
      * Because of https://github.com/seL4/seL4/issues/1536
@@ -132,38 +305,69 @@ static void handler_loop(void)
      */
     {
         seL4_Word irqs_to_ack = microkit_irqs;
-        unsigned int idx = 0;
-        do {
-            if (irqs_to_ack & 1) {
-                microkit_irq_ack(idx);
-            }
-
-            irqs_to_ack >>= 1;
-            idx++;
-        } while (irqs_to_ack != 0);
+        while (irqs_to_ack != 0) {
+            microkit_irq_ack(__builtin_ctzll(irqs_to_ack));
+            irqs_to_ack &= irqs_to_ack - 1;
+        }
     }
 
     for (;;) {
         seL4_Word badge;
         seL4_MessageInfo_t tag;
 
+        /* Called before any deferred signals are sent so that the hook can add to them */
+        if (microkit_before_block) {
+            microkit_before_block();
+        }
+
+        if (microkit_have_signal) {
+            microkit_internal_deferred_signal(microkit_signal_cap, microkit_signal_msg);
+            microkit_have_signal = seL4_False;
+        }
+
+        /* Commit any partial line of debug output so it is visible while we are blocked */
+        if (microkit_log_ring != 0) {
+            microkit_dbg_flush();
+        }
+
 #if defined(CONFIG_VTX)
         if (microkit_x86_vcpu_state.is_on) {
             /* We should never have a reply message from the `protected()` endpoint,
             * as on x86 a PD with a bound vCPU cannot receive PPCs.*/
             // assert(!have_reply);
             tag = x86_vcpu_resume(&badge);
+            /* The message registers from a VM exit have already been written to the IPC buffer */
+            for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+                mrs[i] = seL4_GetMR(i);
+            }
         } else if (have_reply) {
 #else
         if (have_reply) {
 #endif
-            deferred_flush();
-            tag = seL4_ReplyRecv(INPUT_CAP, reply_tag, &badge, REPLY_CAP);
-        } else if (microkit_have_signal) {
-            tag = seL4_NBSendRecv(microkit_signal_cap, microkit_signal_msg, INPUT_CAP, &badge, REPLY_CAP);
-            microkit_have_signal = seL4_False;
+            microkit_internal_deferred_flush();
+            tag = seL4_ReplyRecvWithMRs(INPUT_CAP, reply_tag, &badge, &mrs[0], &mrs[1], &mrs[2], &mrs[3], REPLY_CAP);
+        } else if (microkit_poll_budget != 0) {
+            tag = recv_polling(&badge, mrs);
+        } else if (microkit_deferred_signals_count != 0) {
+            /*
+             * Send all but the last deferred signal back-to-back, the last one
+             * is combined with the Recv. The order signals were deferred in is
+             * kept so that the monitor signal of a passive PD always goes last.
+             */
+            seL4_Word last = microkit_deferred_signals_count - 1;
+            for (seL4_Word i = 0; i < last; i++) {
+                seL4_Send(microkit_deferred_signals[i].cap, microkit_deferred_signals[i].msg);
+            }
+            microkit_deferred_signals_count = 0;
+            microkit_deferred_syscalls_saved++;
+            tag = seL4_NBSendRecvWithMRs(microkit_deferred_signals[last].cap, microkit_deferred_signals[last].msg,
+                                         INPUT_CAP, &badge, &mrs[0], &mrs[1], &mrs[2], &mrs[3], REPLY_CAP);
         } else {
-            tag = seL4_Recv(INPUT_CAP, &badge, REPLY_CAP);
+            tag = seL4_RecvWithMRs(INPUT_CAP, &badge, &mrs[0], &mrs[1], &mrs[2], &mrs[3], REPLY_CAP);
+        }
+
+        if (microkit_after_wake) {
+            microkit_after_wake();
         }
 
         uint64_t is_endpoint = badge >> BADGE_ENDPOINT_BIT;
@@ -171,8 +375,16 @@ static void handler_loop(void)
 
         have_reply = false;
 
+        INSTRUMENT_BEGIN(start);
         if (is_fault) {
-            seL4_Bool reply_to_fault = fault(badge & PD_MASK, tag, &reply_tag);
+            for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+                seL4_SetMR(i, mrs[i]);
+            }
+            microkit_child child = badge & PD_MASK;
+            seL4_Bool reply_to_fault = fault(child, tag, &reply_tag);
+            if (child < MICROKIT_MAX_CHANNELS) {
+                INSTRUMENT_END(start, fault[child]);
+            }
 #if defined(CONFIG_VTX)
             /* If fault() returns false then we shouldn't resume the VCPU. */
             if (!reply_to_fault) {
@@ -183,19 +395,49 @@ static void handler_loop(void)
 #endif
             if (reply_to_fault) {
                 have_reply = true;
+                for (int i = 0; i < MICROKIT_FAST_MRS; i++) {
+                    mrs[i] = seL4_GetMR(i);
+                }
             }
         } else if (is_endpoint) {
             have_reply = true;
-            reply_tag = protected(badge & CHANNEL_MASK, tag);
-        } else {
-            unsigned int idx = 0;
-            do  {
-                if (badge & 1) {
-                    notified(idx);
+            microkit_channel ch = badge & CHANNEL_MASK;
+            reply_tag = protected_fast(ch, tag, mrs);
+            INSTRUMENT_END(start, protected[ch]);
+        } else if (badge != 0) {
+            /* The consumer of the log ring signals when the ring is no longer full,
+             * which we do not wait for as records are dropped instead. */
+            if (microkit_log_ring != 0) {
+                badge &= ~BIT(microkit_log_ch);
+                if (badge == 0) {
+                    continue;
+                }
+            }
+
+            /*
+             * Tell peers on coalesced channels that we need to be signalled again
+             * for anything they send after this point. This must happen before the
+             * user looks at any shared memory in 'notified'.
+             */
+            seL4_Word coalesced = badge & microkit_coalesced;
+            if (coalesced != 0) {
+                while (coalesced != 0) {
+                    microkit_channel ch = __builtin_ctzll(coalesced);
+                    __atomic_store_n(&microkit_internal_coalesce_flag(ch, seL4_False)->pending, 0, __ATOMIC_RELAXED);
+                    coalesced &= coalesced - 1;
                 }
-                badge >>= 1;
-                idx++;
-            } while (badge != 0);
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            }
+            seL4_Word group_bit = BIT(MICROKIT_CHANNEL_GROUP_CHANNEL);
+            if (microkit_channel_groups != NULL && (badge & group_bit) != 0) {
+                if (badge != group_bit) {
+                    notified_batch(badge & ~group_bit);
+                }
+                channel_groups_dispatch();
+            } else {
+                notified_batch(badge);
+            }
+            INSTRUMENT_END(start, notified_batch);
         }
     }
 }
@@ -203,6 +445,7 @@ static void handler_loop(void)
 void main(void)
 {
     run_init_funcs();
+    instrument_init();
     init();
 
     /*
@@ -212,9 +455,7 @@ void main(void)
      * We delay this signal so we are ready waiting on a recv() syscall
      */
     if (microkit_passive) {
-        microkit_have_signal = seL4_True;
-        microkit_signal_msg = seL4_MessageInfo_new(0, 0, 0, 0);
-        microkit_signal_cap = MONITOR_EP;
+        microkit_internal_deferred_signal(MONITOR_EP, seL4_MessageInfo_new(0, 0, 0, 0));
     }
 
     handler_loop();
@@ -0,0 +1,378 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <stdarg.h>
+
+#include <microkit.h>
+
+/*
+ * A small printf for protection domains. It supports the conversions
+ * %d, %i, %u, %x, %X, %o, %p, %s, %c, %n and %%, the flags '-', '0', '+', ' '
+ * and '#', field width and precision (including '*') and the length modifiers
+ * hh, h, l, ll, j, z and t. There is no floating point support, floating point
+ * conversions consume their argument and are output as is.
+ */
+
+/* Where formatted output goes, either a buffer or the debug console */
+struct sink {
+    seL4_Bool console;
+    char *buf;
+    seL4_Word size;
+    seL4_Word len;
+};
+
+static const char digit_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char lower_digits[16] = "0123456789abcdef";
+static const char upper_digits[16] = "0123456789ABCDEF";
+
+static inline void sink_putc(struct sink *sink, char c)
+{
+    if (sink->console) {
+        microkit_dbg_putc(c);
+    } else if (sink->len + 1 < sink->size) {
+        sink->buf[sink->len] = c;
+    }
+    sink->len++;
+}
+
+static void sink_pad(struct sink *sink, char c, int count)
+{
+    while (count-- > 0) {
+        sink_putc(sink, c);
+    }
+}
+
+static void sink_write(struct sink *sink, const char *s, int len)
+{
+    for (int i = 0; i < len; i++) {
+        sink_putc(sink, s[i]);
+    }
+}
+
+/*
+ * Writes the digits of `x` right-aligned ending at `end` and returns a pointer
+ * to the first digit. Decimal conversion handles two digits per division.
+ */
+static char *format_unsigned(char *end, seL4_Uint64 x, unsigned base, const char *digits)
+{
+    char *p = end;
+
+    if (base == 10) {
+        while (x >= 100) {
+            unsigned pair = (x % 100) * 2;
+            x /= 100;
+            *--p = digit_pairs[pair + 1];
+            *--p = digit_pairs[pair];
+        }
+        if (x >= 10) {
+            *--p = digit_pairs[x * 2 + 1];
+            *--p = digit_pairs[x * 2];
+        } else {
+            *--p = '0' + x;
+        }
+    } else {
+        /* Bases 8 and 16 are powers of two so use shifts */
+        unsigned shift = base == 16 ? 4 : 3;
+        do {
+            *--p = digits[x & (base - 1)];
+            x >>= shift;
+        } while (x);
+    }
+
+    return p;
+}
+
+static int format(struct sink *sink, const char *fmt, va_list ap)
+{
+    while (*fmt) {
+        if (*fmt != '%') {
+            sink_putc(sink, *fmt++);
+            continue;
+        }
+        /* Start of the conversion specification, for outputting unsupported ones as is */
+        const char *spec = fmt++;
+
+        seL4_Bool left = seL4_False;
+        seL4_Bool zero = seL4_False;
+        seL4_Bool alt = seL4_False;
+        /* Prefix for non-negative signed conversions, from the '+' and ' ' flags */
+        const char *sign = "";
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                left = seL4_True;
+            } else if (*fmt == '0') {
+                zero = seL4_True;
+            } else if (*fmt == '+') {
+                sign = "+";
+            } else if (*fmt == ' ') {
+                if (sign[0] == '\0') {
+                    sign = " ";
+                }
+            } else if (*fmt == '#') {
+                alt = seL4_True;
+            } else {
+                break;
+            }
+        }
+
+        int width = 0;
+        if (*fmt == '*') {
+            width = va_arg(ap, int);
+            if (width < 0) {
+                left = seL4_True;
+                width = -width;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                width = width * 10 + (*fmt++ - '0');
+            }
+        }
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            if (*fmt == '*') {
+                precision = va_arg(ap, int);
+                /* A negative precision is taken as if it were omitted */
+                if (precision < 0) {
+                    precision = -1;
+                }
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') {
+                    precision = precision * 10 + (*fmt++ - '0');
+                }
+            }
+        }
+
+        /* Number of 'l's, or -1/-2 for 'h'/'hh'. 'L' only applies to floating point. */
+        int length = 0;
+        seL4_Bool long_double = seL4_False;
+        if (*fmt == 'h') {
+            length = -1;
+            if (*++fmt == 'h') {
+                length = -2;
+                fmt++;
+            }
+        } else if (*fmt == 'l') {
+            length = 1;
+            if (*++fmt == 'l') {
+                length = 2;
+                fmt++;
+            }
+        } else if (*fmt == 'j') {
+            length = 2;
+            fmt++;
+        } else if (*fmt == 'z' || *fmt == 't') {
+            length = 1;
+            fmt++;
+        } else if (*fmt == 'L') {
+            long_double = seL4_True;
+            fmt++;
+        }
+
+        char conversion = *fmt;
+        if (conversion == '\0') {
+            break;
+        }
+        fmt++;
+
+        /* Large enough for a 64-bit value in octal */
+        char tmp[24];
+        char *end = tmp + sizeof(tmp);
+        const char *s;
+        int len;
+        const char *prefix = "";
+        seL4_Bool numeric = seL4_True;
+
+        switch (conversion) {
+        case 'd':
+        case 'i': {
+            seL4_Int64 value;
+            if (length >= 2) {
+                value = va_arg(ap, long long);
+            } else if (length == 1) {
+                value = va_arg(ap, long);
+            } else {
+                value = va_arg(ap, int);
+                if (length == -1) {
+                    value = (short)value;
+                } else if (length == -2) {
+                    value = (signed char)value;
+                }
+            }
+            seL4_Uint64 magnitude = value < 0 ? -(seL4_Uint64)value : (seL4_Uint64)value;
+            s = format_unsigned(end, magnitude, 10, lower_digits);
+            /* Zero with a precision of zero is converted to no digits */
+            if (value == 0 && precision == 0) {
+                s = end;
+            }
+            prefix = value < 0 ? "-" : sign;
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'p': {
+            seL4_Uint64 value;
+            if (conversion == 'p') {
+                value = (seL4_Word)va_arg(ap, void *);
+                prefix = "0x";
+            } else if (length >= 2) {
+                value = va_arg(ap, unsigned long long);
+            } else if (length == 1) {
+                value = va_arg(ap, unsigned long);
+            } else {
+                value = va_arg(ap, unsigned int);
+                if (length == -1) {
+                    value = (unsigned short)value;
+                } else if (length == -2) {
+                    value = (unsigned char)value;
+                }
+            }
+            unsigned base = conversion == 'u' ? 10 : conversion == 'o' ? 8 : 16;
+            s = format_unsigned(end, value, base, conversion == 'X' ? upper_digits : lower_digits);
+            if (value == 0 && precision == 0 && conversion != 'p') {
+                s = end;
+            }
+            if (alt && conversion == 'o') {
+                /* The first digit is made zero, unless the precision already does that */
+                if (precision <= end - s && (s == end || *s != '0')) {
+                    prefix = "0";
+                }
+            } else if (alt && value != 0 && conversion != 'u' && conversion != 'p') {
+                prefix = conversion == 'X' ? "0X" : "0x";
+            }
+            break;
+        }
+        case 'c':
+            tmp[0] = va_arg(ap, int);
+            s = tmp;
+            end = tmp + 1;
+            numeric = seL4_False;
+            break;
+        case 's':
+            s = va_arg(ap, const char *);
+            if (s == seL4_Null) {
+                s = "(null)";
+            }
+            for (len = 0; s[len] && (precision < 0 || len < precision); len++);
+            end = (char *)s + len;
+            numeric = seL4_False;
+            break;
+        case 'n':
+            /* Stores the number of characters output so far */
+            if (length >= 2) {
+                *va_arg(ap, long long *) = sink->len;
+            } else if (length == 1) {
+                *va_arg(ap, long *) = sink->len;
+            } else if (length == -1) {
+                *va_arg(ap, short *) = sink->len;
+            } else if (length == -2) {
+                *va_arg(ap, signed char *) = sink->len;
+            } else {
+                *va_arg(ap, int *) = sink->len;
+            }
+            continue;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            /* Floating point is not supported, skip the argument so that the
+             * following conversions still get theirs */
+            if (long_double) {
+                (void)va_arg(ap, long double);
+            } else {
+                (void)va_arg(ap, double);
+            }
+            sink_write(sink, spec, fmt - spec);
+            continue;
+        case '%':
+            sink_putc(sink, '%');
+            continue;
+        default:
+            /* Unknown conversion, output it as is */
+            sink_write(sink, spec, fmt - spec);
+            continue;
+        }
+
+        len = end - s;
+        int prefix_len = prefix[0] == '\0' ? 0 : prefix[1] == '\0' ? 1 : 2;
+        int zeros = 0;
+        if (numeric && precision > len) {
+            zeros = precision - len;
+        }
+        int total = prefix_len + zeros + len;
+        int padding = width > total ? width - total : 0;
+
+        if (numeric && zero && !left && precision < 0) {
+            zeros += padding;
+            padding = 0;
+        }
+        if (!left) {
+            sink_pad(sink, ' ', padding);
+        }
+        sink_write(sink, prefix, prefix_len);
+        sink_pad(sink, '0', zeros);
+        sink_write(sink, s, len);
+        if (left) {
+            sink_pad(sink, ' ', padding);
+        }
+    }
+
+    if (!sink->console && sink->size != 0) {
+        sink->buf[sink->len < sink->size ? sink->len : sink->size - 1] = '\0';
+    }
+
+    return sink->len;
+}
+
+int microkit_vsnprintf(char *buf, seL4_Word size, const char *fmt, va_list ap)
+{
+    struct sink sink = { .console = seL4_False, .buf = buf, .size = size, .len = 0 };
+    return format(&sink, fmt, ap);
+}
+
+int microkit_snprintf(char *buf, seL4_Word size, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int len = microkit_vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return len;
+}
+
+int microkit_vprintf(const char *fmt, va_list ap)
+{
+    struct sink sink = { .console = seL4_True, .buf = seL4_Null, .size = 0, .len = 0 };
+    return format(&sink, fmt, ap);
+}
+
+int microkit_printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int len = microkit_vprintf(fmt, ap);
+    va_end(ap);
+    return len;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * memcpy, memmove, memset and memcmp for PDs, which have no libc. The compiler
+ * also emits calls to these for struct copies and initialisation.
+ *
+ * Only general purpose registers are used, as a PD may not have access to the
+ * FPU (and so to NEON or SSE registers), and the Makefile builds this file with
+ * -mgeneral-regs-only so the compiler does not vectorise the loops either.
+ *
+ * Copies are done a word at a time, with the loops unrolled, when both pointers
+ * share the same alignment. On AArch64, memory mapped with cached="false" is
+ * device memory where unaligned accesses fault, and many RISC-V cores trap on
+ * them, so all other accesses are done a byte at a time. x86-64 handles
+ * unaligned accesses to any memory, so small sizes are handled with a few
+ * possibly overlapping accesses, and 'rep movsb'/'rep stosb' is used for
+ * large sizes.
+ *
+ * The definitions are weak so that a PD can provide its own, e.g. from a libc.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <microkit.h>
+
+#if defined(CONFIG_ARCH_X86_64)
+#define UNALIGNED_OK 1
+/* With enhanced 'rep movsb' (ERMS), the string instructions beat word loops
+ * for large sizes */
+#define REP_THRESHOLD 512
+#else
+#define UNALIGNED_OK 0
+#endif
+
+typedef seL4_Uint64 u64_t __attribute__((may_alias, aligned(1)));
+typedef seL4_Uint32 u32_t __attribute__((may_alias, aligned(1)));
+typedef seL4_Uint16 u16_t __attribute__((may_alias, aligned(1)));
+typedef seL4_Word word_t __attribute__((may_alias));
+
+#define WORD_SIZE sizeof(seL4_Word)
+
+/* Whether `a` and `b` can both be word aligned by skipping the same number of bytes */
+#define MUTUALLY_ALIGNED(a, b) ((((seL4_Word)(a) ^ (seL4_Word)(b)) & (WORD_SIZE - 1)) == 0)
+
+/* Copies at most 16 bytes. All loads are done before the stores so this is
+ * also correct for overlapping buffers. */
+static inline void copy_small(seL4_Uint8 *d, const seL4_Uint8 *s, seL4_Word n)
+{
+#if UNALIGNED_OK
+    if (n >= 8) {
+        seL4_Uint64 head = *(const u64_t *)s;
+        seL4_Uint64 tail = *(const u64_t *)(s + n - 8);
+        *(u64_t *)d = head;
+        *(u64_t *)(d + n - 8) = tail;
+    } else if (n >= 4) {
+        seL4_Uint32 head = *(const u32_t *)s;
+        seL4_Uint32 tail = *(const u32_t *)(s + n - 4);
+        *(u32_t *)d = head;
+        *(u32_t *)(d + n - 4) = tail;
+    } else if (n >= 2) {
+        seL4_Uint16 head = *(const u16_t *)s;
+        seL4_Uint16 tail = *(const u16_t *)(s + n - 2);
+        *(u16_t *)d = head;
+        *(u16_t *)(d + n - 2) = tail;
+    } else if (n == 1) {
+        *d = *s;
+    }
+#else
+    seL4_Uint8 tmp[16];
+    for (seL4_Word i = 0; i < n; i++) {
+        tmp[i] = s[i];
+    }
+    for (seL4_Word i = 0; i < n; i++) {
+        d[i] = tmp[i];
+    }
+#endif
+}
+
+/* Word-wise forward copy, four words per iteration, used when `d` and `s`
+ * are both word aligned */
+static inline void copy_words(seL4_Uint8 *d, const seL4_Uint8 *s, seL4_Word n)
+{
+    word_t *dw = (word_t *)d;
+    const word_t *sw = (const word_t *)s;
+    for (; n >= 4 * WORD_SIZE; n -= 4 * WORD_SIZE) {
+        seL4_Word w0 = sw[0];
+        seL4_Word w1 = sw[1];
+        seL4_Word w2 = sw[2];
+        seL4_Word w3 = sw[3];
+        dw[0] = w0;
+        dw[1] = w1;
+        dw[2] = w2;
+        dw[3] = w3;
+        dw += 4;
+        sw += 4;
+    }
+    for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+        *dw++ = *sw++;
+    }
+    d = (seL4_Uint8 *)dw;
+    s = (const seL4_Uint8 *)sw;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+__attribute__((weak)) void *memcpy(void *restrict dst, const void *restrict src, size_t n)
+{
+    seL4_Uint8 *d = dst;
+    const seL4_Uint8 *s = src;
+
+    if (n <= 16) {
+        copy_small(d, s, n);
+        return dst;
+    }
+
+#if defined(CONFIG_ARCH_X86_64)
+    if (n >= REP_THRESHOLD) {
+        asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) :: "memory");
+        return dst;
+    }
+#endif
+
+    if (MUTUALLY_ALIGNED(d, s)) {
+        while ((seL4_Word)d & (WORD_SIZE - 1)) {
+            *d++ = *s++;
+            n--;
+        }
+        copy_words(d, s, n);
+    } else {
+        for (; n >= 4; n -= 4) {
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = s[3];
+            d += 4;
+            s += 4;
+        }
+        while (n--) {
+            *d++ = *s++;
+        }
+    }
+
+    return dst;
+}
+
+__attribute__((weak)) void *memmove(void *dst, const void *src, size_t n)
+{
+    seL4_Uint8 *d = dst;
+    const seL4_Uint8 *s = src;
+
+    if ((seL4_Word)d - (seL4_Word)s >= n && (seL4_Word)s - (seL4_Word)d >= n) {
+        return memcpy(dst, src, n);
+    }
+
+    if (n <= 16) {
+        copy_small(d, s, n);
+        return dst;
+    }
+
+    /* The buffers overlap. Each word is loaded before it is stored, so copying
+     * in the direction away from the overlap never reads clobbered bytes. */
+    bool words = MUTUALLY_ALIGNED(d, s);
+    if (d < s) {
+        if (words) {
+            for (; (seL4_Word)d & (WORD_SIZE - 1); n--) {
+                *d++ = *s++;
+            }
+            for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+                *(word_t *)d = *(const word_t *)s;
+                d += WORD_SIZE;
+                s += WORD_SIZE;
+            }
+        }
+        while (n--) {
+            *d++ = *s++;
+        }
+    } else {
+        d += n;
+        s += n;
+        if (words) {
+            for (; (seL4_Word)d & (WORD_SIZE - 1); n--) {
+                *--d = *--s;
+            }
+            for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+                d -= WORD_SIZE;
+                s -= WORD_SIZE;
+                *(word_t *)d = *(const word_t *)s;
+            }
+        }
+        while (n--) {
+            *--d = *--s;
+        }
+    }
+
+    return dst;
+}
+
+__attribute__((weak)) void *memset(void *dst, int c, size_t n)
+{
+    seL4_Uint8 *d = dst;
+    seL4_Uint8 b = c;
+    seL4_Word w = (seL4_Word)0x0101010101010101ull * b;
+
+#if UNALIGNED_OK
+    if (n <= 16) {
+        if (n >= 8) {
+            *(u64_t *)d = w;
+            *(u64_t *)(d + n - 8) = w;
+        } else if (n >= 4) {
+            *(u32_t *)d = w;
+            *(u32_t *)(d + n - 4) = w;
+        } else {
+            for (seL4_Word i = 0; i < n; i++) {
+                d[i] = b;
+            }
+        }
+        return dst;
+    }
+#endif
+
+#if defined(CONFIG_ARCH_X86_64)
+    if (n >= REP_THRESHOLD) {
+        asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(b) : "memory");
+        return dst;
+    }
+#endif
+
+    while (n && ((seL4_Word)d & (WORD_SIZE - 1))) {
+        *d++ = b;
+        n--;
+    }
+    word_t *dw = (word_t *)d;
+    for (; n >= 4 * WORD_SIZE; n -= 4 * WORD_SIZE) {
+        dw[0] = w;
+        dw[1] = w;
+        dw[2] = w;
+        dw[3] = w;
+        dw += 4;
+    }
+    for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+        *dw++ = w;
+    }
+    d = (seL4_Uint8 *)dw;
+    while (n--) {
+        *d++ = b;
+    }
+
+    return dst;
+}
+
+__attribute__((weak)) int memcmp(const void *a, const void *b, size_t n)
+{
+    const seL4_Uint8 *x = a;
+    const seL4_Uint8 *y = b;
+
+    /* Skip over equal words, the differing byte is then found below */
+#if UNALIGNED_OK
+    for (; n >= 8; n -= 8) {
+        if (*(const u64_t *)x != *(const u64_t *)y) {
+            break;
+        }
+        x += 8;
+        y += 8;
+    }
+#else
+    if (MUTUALLY_ALIGNED(x, y)) {
+        while (n && ((seL4_Word)x & (WORD_SIZE - 1))) {
+            if (*x != *y) {
+                return *x - *y;
+            }
+            x++;
+            y++;
+            n--;
+        }
+        for (; n >= WORD_SIZE; n -= WORD_SIZE) {
+            if (*(const word_t *)x != *(const word_t *)y) {
+                break;
+            }
+            x += WORD_SIZE;
+            y += WORD_SIZE;
+        }
+    }
+#endif
+
+    for (; n; n--) {
+        if (*x != *y) {
+            return *x - *y;
+        }
+        x++;
+        y++;
+    }
+
+    return 0;
+}
@@ -129,6 +129,20 @@ void arch_init(void)
 #endif
 }
 
+uint64_t arch_timer_ticks(void)
+{
+    uint64_t ticks;
+    asm volatile("isb; mrs %0, cntpct_el0" : "=r"(ticks) :: "memory");
+    return ticks;
+}
+
+uint64_t arch_timer_frequency(void)
+{
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq;
+}
+
 typedef void (*sel4_entry)(
     uintptr_t ui_p_reg_start,
     uintptr_t ui_p_reg_end,
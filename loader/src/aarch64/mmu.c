@@ -10,10 +10,13 @@
 #include "el.h"
 #include "../arch.h"
 #include "../cutil.h"
+#include "../loader.h"
 #include "../uart.h"
 
-void el1_mmu_enable(void);
-void el2_mmu_enable(void);
+void el1_mmu_enable(uint64_t *lvl0_lower, uint64_t *lvl0_upper);
+void el2_mmu_enable(uint64_t *lvl0_lower);
+void el1_mmu_disable(void);
+void el2_mmu_disable(void);
 
 /* Paging structures for kernel mapping */
 uint64_t boot_lvl0_upper[1 << 9] ALIGN(1 << 12);
@@ -37,12 +40,127 @@ int arch_mmu_enable(int logical_cpu)
     LDR_PRINT("INFO", logical_cpu, "enabling MMU\n");
     el = current_el();
     if (el == EL1) {
-        el1_mmu_enable();
+        el1_mmu_enable(boot_lvl0_lower, boot_lvl0_upper);
     } else if (el == EL2) {
-        el2_mmu_enable();
+        el2_mmu_enable(boot_lvl0_lower);
     } else {
         LDR_PRINT("ERROR", logical_cpu, "unknown EL for MMU enable\n");
     }
 
     return 0;
 }
+
+/*
+ * Identity mapping used while copying regions with caches enabled. Unlike
+ * the tables above these are filled in at run-time, with 2MiB blocks covering
+ * the loader image (including its payload), the destination of each region and
+ * the UART.
+ */
+#define COPY_LVL2_TABLES 4
+
+uint64_t copy_lvl0[1 << 9] ALIGN(1 << 12);
+uint64_t copy_lvl1[1 << 9] ALIGN(1 << 12);
+uint64_t copy_lvl2[COPY_LVL2_TABLES][1 << 9] ALIGN(1 << 12);
+static int copy_lvl2_used;
+
+#define BLOCK_BITS_2MB 21
+#define LVL1_BITS 30
+#define LVL0_BITS 39
+
+#define DESC_TABLE 0x3
+#define DESC_BLOCK 0x1
+#define DESC_AF BIT(10)
+#define DESC_SH_OUTER (0x2 << 8)
+#define DESC_SH_INNER (0x3 << 8)
+#define DESC_ATTR_INDEX(x) ((x) << 2)
+
+/* Must match the MAIR set up by el1_mmu_enable and el2_mmu_enable */
+#define MT_DEVICE_nGnRnE 0
+#define MT_NORMAL 4
+
+extern char _text;
+#if defined(CONFIG_PRINTING)
+extern uint32_t *uart_addr __attribute__((weak));
+#endif
+
+static int copy_map(uintptr_t start, uintptr_t end, uint64_t attr_index)
+{
+    /* Normal memory is inner shareable to match the kernel's mappings */
+    uint64_t attrs = DESC_AF | DESC_ATTR_INDEX(attr_index) |
+                     (attr_index == MT_NORMAL ? DESC_SH_INNER : DESC_SH_OUTER) | DESC_BLOCK;
+
+    for (uintptr_t addr = start & ~MASK(BLOCK_BITS_2MB); addr < end; addr += BIT(BLOCK_BITS_2MB)) {
+        /* There is only one level 1 table, covering the first 512GiB */
+        if ((addr >> LVL0_BITS) != 0) {
+            return -1;
+        }
+
+        uint64_t *lvl1_entry = &copy_lvl1[(addr >> LVL1_BITS) & MASK(9)];
+        if (*lvl1_entry == 0) {
+            if (copy_lvl2_used == COPY_LVL2_TABLES) {
+                return -1;
+            }
+            *lvl1_entry = (uintptr_t)copy_lvl2[copy_lvl2_used++] | DESC_TABLE;
+        }
+
+        uint64_t *lvl2 = (uint64_t *)(uintptr_t)(*lvl1_entry & ~MASK(12));
+        lvl2[(addr >> BLOCK_BITS_2MB) & MASK(9)] = addr | attrs;
+    }
+
+    return 0;
+}
+
+void arch_cache_clean_range(uintptr_t start, uintptr_t end)
+{
+    uint64_t ctr;
+    asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+    /* CTR_EL0.DminLine is the log2 of the number of words in the smallest line */
+    uintptr_t line_size = 4 << ((ctr >> 16) & 0xf);
+
+    for (uintptr_t addr = start & ~(line_size - 1); addr < end; addr += line_size) {
+        asm volatile("dc civac, %0" :: "r"(addr) : "memory");
+    }
+    asm volatile("dsb sy" ::: "memory");
+}
+
+int arch_cached_copy_init(void)
+{
+    uintptr_t loader_end = (uintptr_t)loader_data + loader_data->size;
+
+    copy_lvl0[0] = (uintptr_t)copy_lvl1 | DESC_TABLE;
+
+    int r = copy_map((uintptr_t)&_text, loader_end, MT_NORMAL);
+    for (uint32_t i = 0; r == 0 && i < loader_data->num_regions; i++) {
+        const struct region *region = &loader_data->regions[i];
+        r = copy_map(region->load_addr, region->load_addr + region->size, MT_NORMAL);
+    }
+#if defined(CONFIG_PRINTING)
+    /* Mapped last so that device attributes win if it shares a block with memory */
+    if (r == 0 && &uart_addr != NULL) {
+        r = copy_map((uintptr_t)uart_addr, (uintptr_t)uart_addr + 1, MT_DEVICE_nGnRnE);
+    }
+#endif
+
+    return r;
+}
+
+void arch_cached_copy_begin(void)
+{
+    enum el el = current_el();
+    if (el == EL1) {
+        el1_mmu_enable(copy_lvl0, copy_lvl0);
+    } else {
+        el2_mmu_enable(copy_lvl0);
+    }
+}
+
+void arch_cached_copy_end(void)
+{
+    /* Also cleans the loader's own data, such as the stack */
+    enum el el = current_el();
+    if (el == EL1) {
+        el1_mmu_disable();
+    } else {
+        el2_mmu_disable();
+    }
+}
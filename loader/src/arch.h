@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 /**
   * The layout and naming scheme of the functions in these files has meaning:
   *
@@ -35,3 +37,18 @@ void arch_init(void);
 void arch_set_exception_handler(void);
 int arch_mmu_enable(int logical_cpu);
 void arch_jump_to_kernel(int logical_cpu);
+/*
+ * Copying the loader's regions with caches enabled. arch_cached_copy_init()
+ * sets up a cacheable identity mapping, once and before secondary CPUs start.
+ * Each copying CPU then calls arch_cached_copy_begin(), cleans what it copied
+ * to the point of coherency with arch_cache_clean_range(), and returns to
+ * running with the MMU off with arch_cached_copy_end().
+ */
+int arch_cached_copy_init(void);
+void arch_cached_copy_begin(void);
+void arch_cache_clean_range(uintptr_t start, uintptr_t end);
+void arch_cached_copy_end(void);
+/* Free-running timer used to report how long boot steps take */
+uint64_t arch_timer_ticks(void);
+/* Frequency of arch_timer_ticks() in Hz, or 0 if it is not known */
+uint64_t arch_timer_frequency(void);
@@ -7,10 +7,80 @@
 
 #include "cutil.h"
 
+#include <stdint.h>
+
+/*
+ * Copies 64 bytes between word-aligned buffers. All words are loaded before
+ * any are stored so that a forward copy between overlapping buffers (as done
+ * by memmove) is still correct.
+ */
+static inline void copy_block(uint64_t *dst, const uint64_t *src)
+{
+#if defined(ARCH_aarch64)
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7;
+    asm volatile(
+        "ldp %0, %1, [%8, #0]\n"
+        "ldp %2, %3, [%8, #16]\n"
+        "ldp %4, %5, [%8, #32]\n"
+        "ldp %6, %7, [%8, #48]\n"
+        "stp %0, %1, [%9, #0]\n"
+        "stp %2, %3, [%9, #16]\n"
+        "stp %4, %5, [%9, #32]\n"
+        "stp %6, %7, [%9, #48]\n"
+        : "=&r"(t0), "=&r"(t1), "=&r"(t2), "=&r"(t3),
+          "=&r"(t4), "=&r"(t5), "=&r"(t6), "=&r"(t7)
+        : "r"(src), "r"(dst)
+        : "memory"
+    );
+#else
+    uint64_t t0 = src[0], t1 = src[1], t2 = src[2], t3 = src[3];
+    uint64_t t4 = src[4], t5 = src[5], t6 = src[6], t7 = src[7];
+    dst[0] = t0;
+    dst[1] = t1;
+    dst[2] = t2;
+    dst[3] = t3;
+    dst[4] = t4;
+    dst[5] = t5;
+    dst[6] = t6;
+    dst[7] = t7;
+#endif
+}
+
+/*
+ * The loader spends most of its time here copying the kernel and the initial
+ * task image into place, so buffers that share the same alignment within a
+ * word are copied in 64-byte blocks. The loader runs with the MMU disabled,
+ * where unaligned accesses fault, so buffers that cannot both be aligned
+ * are copied a byte at a time.
+ */
 void *memcpy(void *dst, const void *src, size_t sz)
 {
-    char *dst_ = dst;
-    const char *src_ = src;
+    unsigned char *dst_ = dst;
+    const unsigned char *src_ = src;
+
+    if ((((uintptr_t)dst_ ^ (uintptr_t)src_) & (sizeof(uint64_t) - 1)) == 0) {
+        while (((uintptr_t)dst_ & (sizeof(uint64_t) - 1)) != 0 && sz > 0) {
+            *dst_++ = *src_++;
+            sz--;
+        }
+
+        uint64_t *dst_word = (uint64_t *)dst_;
+        const uint64_t *src_word = (const uint64_t *)src_;
+        while (sz >= 8 * sizeof(uint64_t)) {
+            copy_block(dst_word, src_word);
+            dst_word += 8;
+            src_word += 8;
+            sz -= 8 * sizeof(uint64_t);
+        }
+        while (sz >= sizeof(uint64_t)) {
+            *dst_word++ = *src_word++;
+            sz -= sizeof(uint64_t);
+        }
+
+        dst_ = (unsigned char *)dst_word;
+        src_ = (const unsigned char *)src_word;
+    }
+
     while (sz-- > 0) {
         *dst_++ = *src_++;
     }
@@ -0,0 +1,418 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdint.h>
+
+#include "cutil.h"
+#include "inflate.h"
+
+/*
+ * A small DEFLATE decoder for compressed loader regions. Output is written
+ * straight to the region's destination, which also serves as the window for
+ * back-references, so no additional buffers are needed.
+ *
+ * Huffman codes are decoded with a lookup table indexed by the next FAST_BITS
+ * bits of input, which covers the vast majority of symbols. Longer codes fall
+ * back to decoding a bit at a time using the canonical code ordering.
+ */
+
+#define MAX_BITS INFLATE_MAX_BITS
+#define MAX_LCODES 286
+#define MAX_DCODES 30
+#define FIX_LCODES INFLATE_FIX_LCODES
+#define FAST_BITS INFLATE_FAST_BITS
+
+#define ERR_STREAM -1
+#define ERR_CODE -2
+#define ERR_DISTANCE -3
+#define ERR_OUTPUT -4
+
+struct state {
+    uint8_t *out;
+    size_t out_size;
+    size_t out_pos;
+
+    const uint8_t *in;
+    const uint8_t *in_end;
+
+    uint64_t bitbuf;
+    unsigned bitcnt;
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t code_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* Input past the end of the stream reads as zeros; the output size check catches truncation */
+static inline void refill(struct state *s)
+{
+    while (s->bitcnt <= 56) {
+        uint64_t byte = s->in < s->in_end ? *s->in++ : 0;
+        s->bitbuf |= byte << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+static inline uint32_t bits(struct state *s, unsigned n)
+{
+    if (s->bitcnt < n) {
+        refill(s);
+    }
+    uint32_t val = s->bitbuf & MASK(n);
+    s->bitbuf >>= n;
+    s->bitcnt -= n;
+    return val;
+}
+
+static void clear_fast(struct inflate_huffman *h)
+{
+    for (int i = 0; i < BIT(FAST_BITS); i++) {
+        h->fast[i] = 0;
+    }
+}
+
+/*
+ * Build the decoding tables for the code lengths in `lengths`. Returns a
+ * negative value if the code is over-subscribed, zero if it is complete and a
+ * positive value if it is incomplete.
+ */
+static int build(struct inflate_huffman *h, const uint8_t *lengths, int n)
+{
+    uint16_t offs[MAX_BITS + 1];
+    uint16_t next_code[MAX_BITS + 1];
+
+    for (int len = 0; len <= MAX_BITS; len++) {
+        h->count[len] = 0;
+    }
+    for (int sym = 0; sym < n; sym++) {
+        h->count[lengths[sym]]++;
+    }
+    if (h->count[0] == n) {
+        /* No codes; decoding will fail if anything is looked up */
+        clear_fast(h);
+        return 0;
+    }
+
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len < MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for (int sym = 0; sym < n; sym++) {
+        if (lengths[sym] != 0) {
+            h->symbol[offs[lengths[sym]]++] = sym;
+        }
+    }
+
+    unsigned code = 0;
+    next_code[1] = 0;
+    for (int len = 2; len <= MAX_BITS; len++) {
+        code = (code + h->count[len - 1]) << 1;
+        next_code[len] = code;
+    }
+
+    clear_fast(h);
+    for (int sym = 0; sym < n; sym++) {
+        unsigned len = lengths[sym];
+        if (len == 0) {
+            continue;
+        }
+        code = next_code[len]++;
+        if (len > FAST_BITS) {
+            continue;
+        }
+        /* Codes are stored most significant bit first, but bits are read least significant first */
+        unsigned reversed = 0;
+        for (unsigned i = 0; i < len; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        for (unsigned i = reversed; i < BIT(FAST_BITS); i += BIT(len)) {
+            h->fast[i] = (len << 9) | sym;
+        }
+    }
+
+    return left;
+}
+
+static int decode(struct state *s, const struct inflate_huffman *h)
+{
+    if (s->bitcnt < MAX_BITS) {
+        refill(s);
+    }
+
+    uint16_t entry = h->fast[s->bitbuf & MASK(FAST_BITS)];
+    if (entry != 0) {
+        s->bitbuf >>= entry >> 9;
+        s->bitcnt -= entry >> 9;
+        return entry & MASK(9);
+    }
+
+    uint64_t bitbuf = s->bitbuf;
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        code |= bitbuf & 1;
+        bitbuf >>= 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            s->bitbuf = bitbuf;
+            s->bitcnt -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    return ERR_CODE;
+}
+
+static int stored(struct state *s)
+{
+    /* Discard the rest of the current byte */
+    bits(s, s->bitcnt & 7);
+
+    uint32_t len = bits(s, 16);
+    uint32_t nlen = bits(s, 16);
+    if (len != (~nlen & 0xffff)) {
+        return ERR_STREAM;
+    }
+    if (len > s->out_size - s->out_pos) {
+        return ERR_OUTPUT;
+    }
+
+    /* Whole bytes may still be buffered */
+    while (len > 0 && s->bitcnt >= 8) {
+        s->out[s->out_pos++] = bits(s, 8);
+        len--;
+    }
+    if (len > (size_t)(s->in_end - s->in)) {
+        return ERR_STREAM;
+    }
+    memcpy(s->out + s->out_pos, s->in, len);
+    s->out_pos += len;
+    s->in += len;
+
+    return 0;
+}
+
+static int codes(struct state *s, const struct inflate_huffman *lcode, const struct inflate_huffman *dcode)
+{
+    for (;;) {
+        int sym = decode(s, lcode);
+        if (sym < 0) {
+            return sym;
+        }
+
+        if (sym < 256) {
+            if (s->out_pos == s->out_size) {
+                return ERR_OUTPUT;
+            }
+            s->out[s->out_pos++] = sym;
+        } else if (sym == 256) {
+            return 0;
+        } else {
+            sym -= 257;
+            if (sym >= 29) {
+                return ERR_CODE;
+            }
+            size_t len = length_base[sym] + bits(s, length_extra[sym]);
+
+            sym = decode(s, dcode);
+            if (sym < 0) {
+                return sym;
+            }
+            if (sym >= 30) {
+                return ERR_CODE;
+            }
+            size_t dist = dist_base[sym] + bits(s, dist_extra[sym]);
+
+            if (dist > s->out_pos) {
+                return ERR_DISTANCE;
+            }
+            if (len > s->out_size - s->out_pos) {
+                return ERR_OUTPUT;
+            }
+
+            uint8_t *to = s->out + s->out_pos;
+            const uint8_t *from = to - dist;
+            if (dist >= len) {
+                memcpy(to, from, len);
+            } else {
+                /* Overlapping copies repeat the most recent output */
+                for (size_t i = 0; i < len; i++) {
+                    to[i] = from[i];
+                }
+            }
+            s->out_pos += len;
+        }
+    }
+}
+
+static int fixed(struct state *s, struct inflate_workspace *ws)
+{
+    if (!ws->fixed_built) {
+        uint8_t lengths[FIX_LCODES];
+        int sym = 0;
+        for (; sym < 144; sym++) {
+            lengths[sym] = 8;
+        }
+        for (; sym < 256; sym++) {
+            lengths[sym] = 9;
+        }
+        for (; sym < 280; sym++) {
+            lengths[sym] = 7;
+        }
+        for (; sym < FIX_LCODES; sym++) {
+            lengths[sym] = 8;
+        }
+        build(&ws->fixed_lencode, lengths, FIX_LCODES);
+
+        for (sym = 0; sym < MAX_DCODES; sym++) {
+            lengths[sym] = 5;
+        }
+        build(&ws->fixed_distcode, lengths, MAX_DCODES);
+        ws->fixed_built = 1;
+    }
+
+    return codes(s, &ws->fixed_lencode, &ws->fixed_distcode);
+}
+
+static int dynamic(struct state *s, struct inflate_workspace *ws)
+{
+    uint8_t lengths[MAX_LCODES + MAX_DCODES];
+
+    int nlen = bits(s, 5) + 257;
+    int ndist = bits(s, 5) + 1;
+    int ncode = bits(s, 4) + 4;
+    if (nlen > MAX_LCODES || ndist > MAX_DCODES) {
+        return ERR_STREAM;
+    }
+
+    int index;
+    for (index = 0; index < ncode; index++) {
+        lengths[code_length_order[index]] = bits(s, 3);
+    }
+    for (; index < 19; index++) {
+        lengths[code_length_order[index]] = 0;
+    }
+    if (build(&ws->lencode, lengths, 19) != 0) {
+        return ERR_STREAM;
+    }
+
+    index = 0;
+    while (index < nlen + ndist) {
+        int sym = decode(s, &ws->lencode);
+        if (sym < 0) {
+            return sym;
+        }
+        if (sym < 16) {
+            lengths[index++] = sym;
+            continue;
+        }
+
+        uint8_t len = 0;
+        int repeat;
+        if (sym == 16) {
+            if (index == 0) {
+                return ERR_STREAM;
+            }
+            len = lengths[index - 1];
+            repeat = 3 + bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + bits(s, 3);
+        } else {
+            repeat = 11 + bits(s, 7);
+        }
+        if (index + repeat > nlen + ndist) {
+            return ERR_STREAM;
+        }
+        while (repeat--) {
+            lengths[index++] = len;
+        }
+    }
+
+    /* There must be an end-of-block code */
+    if (lengths[256] == 0) {
+        return ERR_STREAM;
+    }
+
+    /* Incomplete literal/length codes are only allowed if there is a single code */
+    int err = build(&ws->lencode, lengths, nlen);
+    if (err < 0 || (err > 0 && nlen - ws->lencode.count[0] != 1)) {
+        return ERR_STREAM;
+    }
+    err = build(&ws->distcode, lengths + nlen, ndist);
+    if (err < 0 || (err > 0 && ndist - ws->distcode.count[0] != 1)) {
+        return ERR_STREAM;
+    }
+
+    return codes(s, &ws->lencode, &ws->distcode);
+}
+
+int inflate(struct inflate_workspace *ws, void *dst, size_t dst_size, const void *src, size_t src_size)
+{
+    struct state s = {
+        .out = dst,
+        .out_size = dst_size,
+        .out_pos = 0,
+        .in = src,
+        .in_end = (const uint8_t *)src + src_size,
+        .bitbuf = 0,
+        .bitcnt = 0,
+    };
+
+    int last;
+    do {
+        last = bits(&s, 1);
+        int type = bits(&s, 2);
+        int err;
+        if (type == 0) {
+            err = stored(&s);
+        } else if (type == 1) {
+            err = fixed(&s, ws);
+        } else if (type == 2) {
+            err = dynamic(&s, ws);
+        } else {
+            err = ERR_STREAM;
+        }
+        if (err != 0) {
+            return err;
+        }
+    } while (!last);
+
+    if (s.out_pos != dst_size) {
+        return ERR_OUTPUT;
+    }
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2026, UNSW
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INFLATE_MAX_BITS 15
+#define INFLATE_FIX_LCODES 288
+#define INFLATE_FAST_BITS 9
+
+struct inflate_huffman {
+    /* Number of symbols with each code length */
+    uint16_t count[INFLATE_MAX_BITS + 1];
+    /* Symbols ordered by code */
+    uint16_t symbol[INFLATE_FIX_LCODES];
+    /* (code length << 9) | symbol for codes of at most INFLATE_FAST_BITS, otherwise 0 */
+    uint16_t fast[1 << INFLATE_FAST_BITS];
+};
+
+/* Decoding tables, too large for the loader's stack. Each concurrent caller needs its own. */
+struct inflate_workspace {
+    struct inflate_huffman lencode;
+    struct inflate_huffman distcode;
+    struct inflate_huffman fixed_lencode;
+    struct inflate_huffman fixed_distcode;
+    int fixed_built;
+};
+
+/*
+ * Decompress the raw DEFLATE (RFC 1951) stream at `src`, which is at most
+ * `src_size` bytes, directly into `dst`. The stream must decompress to exactly
+ * `dst_size` bytes.
+ *
+ * Returns 0 on success and a negative value if the stream is malformed.
+ */
+int inflate(struct inflate_workspace *ws, void *dst, size_t dst_size, const void *src, size_t src_size);
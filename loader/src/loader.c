@@ -10,6 +10,7 @@
 #include "arch.h"
 #include "cpus.h"
 #include "cutil.h"
+#include "inflate.h"
 #include "uart.h"
 
 _Static_assert(sizeof(uintptr_t) == 8 || sizeof(uintptr_t) == 4, "Expect uintptr_t to be 32-bit or 64-bit");
@@ -82,15 +83,118 @@ static void print_loader_data(void)
     }
 }
 
-static void copy_data(void)
+#if defined(CACHED_COPY)
+static int cached_copy;
+#endif
+
+static struct inflate_workspace inflate_workspace[NUM_ACTIVE_CPUS];
+
+/*
+ * The part [*start, *end) of region `index`, relative to the start of the
+ * region, that `logical_cpu` copies.
+ */
+static void region_share(uint32_t index, int logical_cpu, uintptr_t *start, uintptr_t *end)
+{
+    const struct region *r = &loader_data->regions[index];
+#if defined(PARALLEL_COPY)
+    uintptr_t cpus = plat_get_active_cpus();
+
+    /* A compressed region has to be decompressed from its start so only one CPU can do it */
+    if (r->type == REGION_TYPE_DEFLATE) {
+        *start = 0;
+        *end = index % cpus == logical_cpu ? r->size : 0;
+        return;
+    }
+
+    /* Otherwise split the region evenly in page multiples */
+    uintptr_t chunk = (((r->size + cpus - 1) / cpus) + MASK(12)) & ~MASK(12);
+    *start = chunk * logical_cpu < r->size ? chunk * logical_cpu : r->size;
+    *end = *start + chunk < r->size ? *start + chunk : r->size;
+#else
+    *start = 0;
+    *end = r->size;
+#endif
+}
+
+static void copy_data(int logical_cpu)
 {
     const void *base = &loader_data->regions[loader_data->num_regions];
+
+    /* Includes the time taken to set up and tear down the cached copy */
+    uint64_t copy_start = arch_timer_ticks();
+#if defined(CACHED_COPY)
+    if (cached_copy) {
+        arch_cached_copy_begin();
+    }
+#endif
+
     for (uint32_t i = 0; i < loader_data->num_regions; i++) {
         const struct region *r = &loader_data->regions[i];
-        puts("LDR|INFO: copying region ");
-        puthex32(i);
-        puts("\n");
-        memcpy((void *)(uintptr_t)r->load_addr, base + r->offset, r->size);
+        uintptr_t share_start, share_end;
+        region_share(i, logical_cpu, &share_start, &share_end);
+        if (share_start == share_end) {
+            continue;
+        }
+
+        /* The tool may have placed the region in the image at its load address */
+        if (r->type == REGION_TYPE_DATA && (uintptr_t)base + r->offset == r->load_addr) {
+            if (logical_cpu == 0) {
+                puts("LDR|INFO: region ");
+                puthex32(i);
+                puts(" already in place\n");
+            }
+            continue;
+        }
+
+        /* Only the boot CPU prints so that output from several CPUs does not interleave */
+        if (logical_cpu == 0) {
+            puts("LDR|INFO: copying region ");
+            puthex32(i);
+            puts("\n");
+        }
+        uint64_t start = arch_timer_ticks();
+        if (r->type == REGION_TYPE_DEFLATE) {
+            /* The stream cannot extend past the end of the loader data */
+            size_t src_size = ((uintptr_t)loader_data + loader_data->size) - ((uintptr_t)base + r->offset);
+            int err = inflate(&inflate_workspace[logical_cpu], (void *)(uintptr_t)r->load_addr, r->size,
+                              base + r->offset, src_size);
+            if (err != 0) {
+                LDR_PRINT("ERROR", logical_cpu, "failed to decompress region ");
+                puthex32(i);
+                puts(": ");
+                puthex32(err);
+                puts("\n");
+                fail();
+            }
+        } else {
+            memcpy((void *)(uintptr_t)(r->load_addr + share_start), base + r->offset + share_start,
+                   share_end - share_start);
+        }
+#if defined(CACHED_COPY)
+        if (cached_copy) {
+            arch_cache_clean_range(r->load_addr + share_start, r->load_addr + share_end);
+        }
+#endif
+        uint64_t ticks = arch_timer_ticks() - start;
+        if (logical_cpu == 0) {
+            puts("LDR|INFO: copied region ");
+            puthex32(i);
+            puts(" in ");
+            puthex64(ticks);
+            puts(" ticks\n");
+        }
+    }
+
+#if defined(CACHED_COPY)
+    if (cached_copy) {
+        arch_cached_copy_end();
+    }
+#endif
+
+    if (logical_cpu == 0) {
+        puts("LDR|INFO: copied all regions in ");
+        puthex64(arch_timer_ticks() - copy_start);
+        puts(" ticks\n");
     }
 }
 
@@ -98,8 +202,48 @@ static void copy_data(void)
 static int print_lock = 0;
 #endif
 
+#if defined(PARALLEL_COPY)
+/*
+ * Per-CPU flags rather than a counter, as the copy runs with the MMU off where
+ * exclusive accesses may not be supported.
+ */
+static int copy_done[NUM_ACTIVE_CPUS];
+/* The logical CPU (modulo the number of CPUs) that may continue to the kernel */
+static int boot_turn = 1;
+static uint64_t parallel_copy_start;
+
+static void parallel_copy(int logical_cpu)
+{
+#ifdef CONFIG_PRINTING
+    /* Let the boot CPU start the next CPU */
+    if (logical_cpu != 0) {
+        __atomic_store_n(&print_lock, 1, __ATOMIC_RELEASE);
+    }
+#endif
+
+    copy_data(logical_cpu);
+    __atomic_store_n(&copy_done[logical_cpu], 1, __ATOMIC_RELEASE);
+
+    for (int cpu = 0; cpu < plat_get_active_cpus(); cpu++) {
+        while (__atomic_load_n(&copy_done[cpu], __ATOMIC_ACQUIRE) != 1);
+    }
+    if (logical_cpu == 0) {
+        puts("LDR|INFO: all CPUs finished copying in ");
+        puthex64(arch_timer_ticks() - parallel_copy_start);
+        puts(" ticks\n");
+    }
+
+    /* Continue one CPU at a time, secondary CPUs first, as when copying on one CPU */
+    while (__atomic_load_n(&boot_turn, __ATOMIC_ACQUIRE) % plat_get_active_cpus() != logical_cpu);
+}
+#endif
+
 void start_kernel(int logical_cpu)
 {
+#if defined(PARALLEL_COPY)
+    parallel_copy(logical_cpu);
+#endif
+
     LDR_PRINT("INFO", logical_cpu, "enabling MMU\n");
     int r = arch_mmu_enable(logical_cpu);
     if (r != 0) {
@@ -114,6 +258,9 @@ void start_kernel(int logical_cpu)
 #ifdef CONFIG_PRINTING
     __atomic_store_n(&print_lock, 1, __ATOMIC_RELEASE);
 #endif
+#if defined(PARALLEL_COPY)
+    __atomic_store_n(&boot_turn, logical_cpu + 1, __ATOMIC_RELEASE);
+#endif
 
     arch_jump_to_kernel(logical_cpu);
 
@@ -166,10 +313,30 @@ int main(void)
 
     print_loader_data();
 
+    uint64_t freq = arch_timer_frequency();
+    if (freq != 0) {
+        puts("LDR|INFO: timer frequency: ");
+        puthex64(freq);
+        puts(" Hz\n");
+    }
+
+#if defined(CACHED_COPY)
+    cached_copy = arch_cached_copy_init() == 0;
+    if (!cached_copy) {
+        puts("LDR|WARNING: unable to map regions for cached copy, copying uncached\n");
+    }
+#endif
+
     /* past here we have trashed u-boot so any errors should go to the
      * fail label; it's not possible to return to U-boot
      */
-    copy_data();
+#if defined(PARALLEL_COPY)
+    /* Secondary CPUs copy their share of the regions in start_kernel() */
+    puts("LDR|INFO: copying regions on all active CPUs\n");
+    parallel_copy_start = arch_timer_ticks();
+#else
+    copy_data(0);
+#endif
 
     LDR_PRINT("INFO", 0, "active CPUs to start: ");
     puthex32(plat_get_active_cpus());
@@ -11,6 +11,8 @@
 
 #define REGION_TYPE_DATA 1
 #define REGION_TYPE_ZERO 2
+/* Region data is a raw DEFLATE stream that decompresses to `size` bytes */
+#define REGION_TYPE_DEFLATE 3
 
 #ifndef __ASSEMBLER__
 
@@ -19,6 +19,19 @@ void arch_init(void)
     puts("\n");
 }
 
+uint64_t arch_timer_ticks(void)
+{
+    uint64_t ticks;
+    asm volatile("rdtime %0" : "=r"(ticks));
+    return ticks;
+}
+
+uint64_t arch_timer_frequency(void)
+{
+    /* The timebase frequency is only described by the device tree */
+    return 0;
+}
+
 typedef void (*sel4_entry)(
     uintptr_t ui_p_reg_start,
     uintptr_t ui_p_reg_end,
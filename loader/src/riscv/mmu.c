@@ -26,6 +26,24 @@ uint64_t boot_lvl2_pt_loader[1 << 9] ALIGN(1 << 12);
 
 #define RISCV_PGSHIFT 12
 
+/*
+ * Cacheability on RISC-V is given by the physical memory attributes rather than
+ * by satp, so the copy already runs with caches enabled.
+ */
+int arch_cached_copy_init(void)
+{
+    return 0;
+}
+
+void arch_cached_copy_begin(void) {}
+
+void arch_cache_clean_range(uintptr_t start, uintptr_t end) {}
+
+void arch_cached_copy_end(void)
+{
+    asm volatile("fence rw, rw" ::: "memory");
+}
+
 int arch_mmu_enable(int logical_cpu)
 {
     // The RISC-V privileged spec (20211203), section 4.1.11 says that the
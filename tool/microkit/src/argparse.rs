@@ -31,6 +31,8 @@ pub fn print_help(sdk: &Sdk) {
     println!("  --capdl-json CAPDL_SPEC (JSON format)");
     println!("  --viper-output DIRECTORY_PATH");
     println!("  --search-path [SEARCH_PATH ...]");
+    println!("  --compress-regions");
+    println!("  --in-place-regions");
 }
 
 #[derive(Debug, Clone)]
@@ -75,6 +77,8 @@ pub struct Args {
     pub search_paths: Vec<PathBuf>,
     pub requested_image_type: RequestedImageType,
     pub override_kernel: Option<PathBuf>,
+    pub compress_regions: bool,
+    pub in_place_regions: bool,
 }
 
 #[derive(Debug)]
@@ -177,6 +181,8 @@ impl Args {
         let mut config = None;
         let mut requested_image_type = RequestedImageType::Unspecified;
         let mut override_kernel = None;
+        let mut compress_regions = false;
+        let mut in_place_regions = false;
 
         while let Some(arg) = args.next() {
             match arg.as_str() {
@@ -226,6 +232,12 @@ impl Args {
                     override_kernel =
                         Some(consume_parameter(&mut args, "--override-kernel")?.into());
                 }
+                "--compress-regions" => {
+                    compress_regions = true;
+                }
+                "--in-place-regions" => {
+                    in_place_regions = true;
+                }
                 value => {
                     if sdf_path.is_none() {
                         sdf_path = Some(value.into());
@@ -273,6 +285,8 @@ impl Args {
             search_paths,
             requested_image_type,
             override_kernel,
+            compress_regions,
+            in_place_regions,
         })
     }
 }
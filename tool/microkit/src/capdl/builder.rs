@@ -7,7 +7,8 @@ use core::ops::Range;
 
 use std::{
     cmp::{min, Ordering},
-    collections::HashMap,
+    collections::{hash_map::DefaultHasher, HashMap},
+    hash::{Hash, Hasher},
 };
 
 use sel4_capdl_initializer_types::{
@@ -24,8 +25,8 @@ use crate::{
     },
     elf::ElfFile,
     sdf::{
-        CapMapType, CpuCore, SysMap, SysMapPerms, SystemDescription, BUDGET_DEFAULT,
-        MONITOR_PD_NAME, MONITOR_PRIORITY,
+        CapMapType, ChannelEnd, CpuCore, SysMap, SysMapPerms, SystemDescription, BUDGET_DEFAULT,
+        CHANNEL_GROUP_ID, CHANNEL_GROUP_MIN_ID, MONITOR_PD_NAME, MONITOR_PRIORITY,
     },
     sel4::{Arch, Config, PageSize},
     util::{ranges_overlap, round_down, round_up},
@@ -98,6 +99,11 @@ const PD_ROOT_CAP_SIZE: u32 = 64;
 const PD_ROOT_CAP_BITS: u8 = PD_ROOT_CAP_SIZE.ilog2() as u8;
 pub const PD_CAP_SIZE: u32 = 512;
 const PD_CAP_BITS: u8 = PD_CAP_SIZE.ilog2() as u8;
+/* PDs with channel groups have a larger CSpace to hold the output notification caps of
+ * the channel group IDs, starting after the regular slots. This should be kept in sync
+ * with `BASE_GROUP_OUTPUT_NOTIFICATION_CAP` in libmicrokit/include/microkit.h */
+const PD_BASE_GROUP_OUTPUT_NOTIFICATION_CAP: u64 = PD_CAP_SIZE as u64;
+const PD_CHANNEL_GROUPS_CAP_BITS: u8 = 11;
 const PD_SCHEDCONTEXT_EXTRA_SIZE: u64 = 256;
 const PD_SCHEDCONTEXT_EXTRA_SIZE_BITS: u64 = PD_SCHEDCONTEXT_EXTRA_SIZE.ilog2() as u64;
 
@@ -107,6 +113,58 @@ pub const SLOT_SIZE: u64 = 1 << SLOT_BITS;
 pub type FrameFill = Fill<FillContent>;
 pub type CapDLNamedObject = NamedObject<FrameFill>;
 
+/// Returns the parts of `range` within `data` that contain any non-zero bytes, split at
+/// small page granularity. Adjacent non-zero parts are merged.
+fn nonzero_ranges(data: &[u8], range: Range<u64>) -> Vec<Range<u64>> {
+    let mut ranges: Vec<Range<u64>> = Vec::new();
+    let mut start = range.start;
+    while start < range.end {
+        let end = min(start + PageSize::Small as u64, range.end);
+        if data[start as usize..end as usize].iter().any(|&b| b != 0) {
+            match ranges.last_mut() {
+                Some(last) if last.end == start => last.end = end,
+                _ => ranges.push(start..end),
+            }
+        }
+        start = end;
+    }
+    ranges
+}
+
+/// The content of a frame of `size` bytes filled from ELF data by `fill`.
+fn frame_content(elfs: &[ElfFile], size: u64, fill: &FrameFill) -> Vec<u8> {
+    let mut content = vec![0; size as usize];
+    for entry in fill.entries.iter() {
+        if let FillEntryContent::Data(FillContent::ElfContent(elf_content)) = &entry.content {
+            let segment = elfs[elf_content.elf_id].loadable_segments()[elf_content.elf_seg_idx];
+            content[entry.range.start as usize..entry.range.end as usize]
+                .copy_from_slice(&segment.data()[elf_content.elf_seg_data_range.clone()]);
+        }
+    }
+
+    content
+}
+
+/// Slot of the cap used by `end` to notify the other end of a channel.
+fn output_notification_cap_idx(end: &ChannelEnd) -> u64 {
+    if end.is_group_id() {
+        PD_BASE_GROUP_OUTPUT_NOTIFICATION_CAP + end.id - CHANNEL_GROUP_MIN_ID
+    } else {
+        PD_BASE_OUTPUT_NOTIFICATION_CAP + end.id
+    }
+}
+
+/// Badge of the notifications received by `end`. Channel group IDs do not have a
+/// badge bit of their own, the sender marks them as pending in the channel groups
+/// bitmap of the receiver instead.
+fn notification_badge(end: &ChannelEnd) -> u64 {
+    if end.is_group_id() {
+        1 << CHANNEL_GROUP_ID
+    } else {
+        1 << end.id
+    }
+}
+
 pub struct ExpectedAllocation {
     pub ut_idx: usize,
     pub paddr: u64,
@@ -126,6 +184,11 @@ pub struct CapDLSpecContainer {
     pub spec: Spec<FrameFill>,
     /// Track allocations as we build the system for later use by the report.
     pub expected_allocations: HashMap<ObjectId, ExpectedAllocation>,
+    /// Read-only ELF frames by sharing group, size bits and a hash of their content, so
+    /// that frames with identical content can be shared between PDs when requested.
+    /// The content itself is compared on a hash match, as different content may
+    /// have the same hash.
+    readonly_elf_frames: HashMap<(String, u8, u64), Vec<ObjectId>>,
 }
 
 impl Default for CapDLSpecContainer {
@@ -153,6 +216,7 @@ impl CapDLSpecContainer {
                 domain_set_start: None,
             },
             expected_allocations: HashMap::new(),
+            readonly_elf_frames: HashMap::new(),
         }
     }
 
@@ -187,6 +251,10 @@ impl CapDLSpecContainer {
     /// -> TCB: Program counter set and VSpace capability bound.
     /// -> VSpace: all pages from the ELF mapped in.
     /// Returns the object ID of the TCB
+    /// If `large_pages` is set, parts of segments that cover whole large pages are mapped
+    /// with large pages rather than small pages.
+    /// If `share_group` is set, frames of read-only segments reuse an existing frame
+    /// with identical content created by an earlier call with the same `share_group`.
     /// NOTE that all ELF frames will just be reference to the original ELF object rather than the actual data.
     /// So that symbols can be patched before the frames' data are filled in.
     fn add_elf_to_spec(
@@ -195,8 +263,11 @@ impl CapDLSpecContainer {
         pd_name: &str,
         pd_cpu: CpuCore,
         elf_id: usize,
-        elf: &ElfFile,
+        elfs: &[ElfFile],
+        large_pages: bool,
+        share_group: Option<&str>,
     ) -> Result<ObjectId, String> {
+        let elf = &elfs[elf_id];
         // We assumes that ELFs and PDs have a one-to-one relationship. So for each ELF we create a VSpace.
         let vspace_obj_id = create_vspace(self, sel4_config, pd_name);
         let vspace_cap = capdl_util_make_page_table_cap(vspace_obj_id);
@@ -210,13 +281,23 @@ impl CapDLSpecContainer {
 
             let seg_base_vaddr = segment.virt_addr;
             let seg_mem_size: u64 = segment.mem_size();
-
-            let page_size = PageSize::Small;
-            let page_size_bytes = page_size as u64;
+            let seg_end_vaddr = round_up(seg_base_vaddr + seg_mem_size, PageSize::Small as u64);
 
             // Create and map all frames for this segment.
-            let mut cur_vaddr = round_down(seg_base_vaddr, page_size_bytes);
+            let mut cur_vaddr = round_down(seg_base_vaddr, PageSize::Small as u64);
             while cur_vaddr < seg_base_vaddr + seg_mem_size {
+                // A large page is only used if it is entirely within the segment, so that
+                // it cannot clash with other segments or mappings.
+                let page_size = if large_pages
+                    && cur_vaddr.is_multiple_of(PageSize::Large as u64)
+                    && seg_end_vaddr - cur_vaddr >= PageSize::Large as u64
+                {
+                    PageSize::Large
+                } else {
+                    PageSize::Small
+                };
+                let page_size_bytes = page_size as u64;
+
                 let mut frame_fill = Fill {
                     entries: [].to_vec(),
                 };
@@ -238,28 +319,64 @@ impl CapDLSpecContainer {
                     let len_to_cpy =
                         min(page_size_bytes - dest_offset, seg_mem_size - section_offset);
 
-                    frame_fill.entries.push(FillEntry {
-                        range: Range {
-                            start: dest_offset,
-                            end: dest_offset + len_to_cpy,
-                        },
-                        content: FillEntryContent::Data(FillContent::ElfContent(ElfContent {
-                            elf_id,
-                            elf_seg_idx: seg_idx,
-                            elf_seg_data_range: (section_offset as usize
-                                ..((section_offset + len_to_cpy) as usize)),
-                        })),
-                    });
+                    // Frames are zeroed when created, so only the parts with non-zero data need filling.
+                    for data_range in
+                        nonzero_ranges(segment.data(), section_offset..section_offset + len_to_cpy)
+                    {
+                        let start = dest_offset + (data_range.start - section_offset);
+                        frame_fill.entries.push(FillEntry {
+                            range: Range {
+                                start,
+                                end: start + (data_range.end - data_range.start),
+                            },
+                            content: FillEntryContent::Data(FillContent::ElfContent(ElfContent {
+                                elf_id,
+                                elf_seg_idx: seg_idx,
+                                elf_seg_data_range: (data_range.start as usize
+                                    ..data_range.end as usize),
+                            })),
+                        });
+                    }
                 }
 
                 // Create the frame object, cap to the object, add it to the spec and map it in.
-                let frame_obj_id = capdl_util_make_frame_obj(
-                    self,
-                    frame_fill,
-                    &format!("elf_{pd_name}_{frame_sequence:09}"),
-                    None,
-                    PageSize::Small.fixed_size_bits(sel4_config) as u8,
-                );
+                let size_bits = page_size.fixed_size_bits(sel4_config) as u8;
+                let frame_name = format!("elf_{pd_name}_{frame_sequence:09}");
+                let frame_obj_id =
+                    if let Some(share_group) = share_group.filter(|_| !segment.is_writable()) {
+                        let content = frame_content(elfs, page_size_bytes, &frame_fill);
+                        let mut hasher = DefaultHasher::new();
+                        content.hash(&mut hasher);
+                        let key = (share_group.to_string(), size_bits, hasher.finish());
+                        let existing = self.readonly_elf_frames.get(&key).and_then(|frames| {
+                            frames.iter().copied().find(|&frame_obj_id| {
+                                let Object::Frame(frame) =
+                                    &self.get_root_object(frame_obj_id).unwrap().object
+                                else {
+                                    unreachable!("internal bug: shared ELF frame is not a frame");
+                                };
+                                frame_content(elfs, page_size_bytes, &frame.init) == content
+                            })
+                        });
+                        if let Some(frame_obj_id) = existing {
+                            frame_obj_id
+                        } else {
+                            let frame_obj_id = capdl_util_make_frame_obj(
+                                self,
+                                frame_fill,
+                                &frame_name,
+                                None,
+                                size_bits,
+                            );
+                            self.readonly_elf_frames
+                                .entry(key)
+                                .or_default()
+                                .push(frame_obj_id);
+                            frame_obj_id
+                        }
+                    } else {
+                        capdl_util_make_frame_obj(self, frame_fill, &frame_name, None, size_bits)
+                    };
                 let frame_cap = capdl_util_make_frame_cap(
                     frame_obj_id,
                     segment.is_readable(),
@@ -356,6 +473,28 @@ fn map_memory_region(
     }
 }
 
+/// The frames backing the stack of a PD, from the bottom up. Large pages are used for
+/// the parts of the stack that are aligned to them, which is never the top of the stack
+/// as the guard page and IPC buffer take up the rest of the highest large page.
+fn pd_stack_frames(kernel_config: &Config, stack_size: u64) -> Vec<(u64, PageSize)> {
+    let mut frames = Vec::new();
+    let mut cur_vaddr = kernel_config.pd_stack_bottom(stack_size);
+    let stack_top = kernel_config.pd_stack_top();
+    while cur_vaddr < stack_top {
+        let page_size = if cur_vaddr.is_multiple_of(PageSize::Large as u64)
+            && stack_top - cur_vaddr >= PageSize::Large as u64
+        {
+            PageSize::Large
+        } else {
+            PageSize::Small
+        };
+        frames.push((cur_vaddr, page_size));
+        cur_vaddr += page_size as u64;
+    }
+
+    frames
+}
+
 /// Build a CapDL Spec according to the System Description File.
 pub fn build_capdl_spec(
     kernel_config: &Config,
@@ -371,18 +510,17 @@ pub fn build_capdl_spec(
     // We expect the PD ELFs to be first and the monitor ELF last in the list of ELFs.
     let mon_elf_id = elfs.len() - 1;
     assert!(elfs.len() == system.protection_domains.len() + 1);
-    let monitor_tcb_obj_id = {
-        let monitor_elf = &elfs[mon_elf_id];
-        spec_container
-            .add_elf_to_spec(
-                kernel_config,
-                MONITOR_PD_NAME,
-                CpuCore(0),
-                mon_elf_id,
-                monitor_elf,
-            )
-            .unwrap()
-    };
+    let monitor_tcb_obj_id = spec_container
+        .add_elf_to_spec(
+            kernel_config,
+            MONITOR_PD_NAME,
+            CpuCore(0),
+            mon_elf_id,
+            elfs,
+            true,
+            None,
+        )
+        .unwrap();
 
     // Create monitor fault endpoint object + cap
     let mon_fault_ep_obj_id =
@@ -588,8 +726,20 @@ pub fn build_capdl_spec(
         let mut caps_to_insert_to_pd_cspace: Vec<CapTableEntry> = Vec::new();
 
         // Step 3-1: Create TCB and VSpace with all ELF loadable frames mapped in.
+        // Read-only frames are shared between PDs using the same program image that opted in.
+        let share_group = pd
+            .share_readonly
+            .then(|| pd.program_image.display().to_string());
         let pd_tcb_obj_id = spec_container
-            .add_elf_to_spec(kernel_config, &pd.name, pd.cpu, pd_global_idx, elf_obj)
+            .add_elf_to_spec(
+                kernel_config,
+                &pd.name,
+                pd.cpu,
+                pd_global_idx,
+                elfs,
+                pd.elf_large_pages,
+                share_group.as_deref(),
+            )
             .unwrap();
         let pd_vspace_obj_id = capdl_util_get_vspace_id_from_tcb_id(&spec_container, pd_tcb_obj_id);
 
@@ -669,11 +819,14 @@ pub fn build_capdl_spec(
             ipcbuf_frame_cap,
         ));
 
-        // Step 3-3b: Create and map in the stack (bottom up)
-        let mut cur_stack_vaddr = kernel_config.pd_stack_bottom(pd.stack_size);
-        pd_stack_bottoms.push(cur_stack_vaddr);
-        let num_stack_frames = pd.stack_size / PageSize::Small as u64;
-        for stack_frame_seq in 0..num_stack_frames {
+        // Step 3-3b: Create and map in the stack. The page below the stack is left
+        // unmapped as a guard, see `pd_map_max_vaddr`.
+        pd_stack_bottoms.push(kernel_config.pd_stack_bottom(pd.stack_size));
+        for (stack_frame_seq, (cur_stack_vaddr, page_size)) in
+            pd_stack_frames(kernel_config, pd.stack_size)
+                .into_iter()
+                .enumerate()
+        {
             let stack_frame_obj_id = capdl_util_make_frame_obj(
                 &mut spec_container,
                 Fill {
@@ -681,7 +834,7 @@ pub fn build_capdl_spec(
                 },
                 &format!("{}_stack_{:09}", pd.name, stack_frame_seq),
                 None,
-                PageSize::Small.fixed_size_bits(kernel_config) as u8,
+                page_size.fixed_size_bits(kernel_config) as u8,
             );
             let stack_frame_cap =
                 capdl_util_make_frame_cap(stack_frame_obj_id, true, true, false, true);
@@ -691,11 +844,10 @@ pub fn build_capdl_spec(
                 &pd.name,
                 pd_vspace_obj_id,
                 stack_frame_cap,
-                PageSize::Small as u64,
+                page_size as u64,
                 cur_stack_vaddr,
             )
             .unwrap();
-            cur_stack_vaddr += PageSize::Small as u64;
         }
 
         // Step 3-4 Create Scheduling Context
@@ -1014,14 +1166,19 @@ pub fn build_capdl_spec(
         }
 
         // Step 3-13 Create CSpace and add all caps that the PD code and libmicrokit need to access.
+        let pd_cap_bits = if pd.channel_groups_vaddr.is_some() {
+            PD_CHANNEL_GROUPS_CAP_BITS
+        } else {
+            PD_CAP_BITS
+        };
         let pd_cnode_obj_id = capdl_util_make_cnode_obj(
             &mut spec_container,
             &pd.name,
-            PD_CAP_BITS,
+            pd_cap_bits,
             caps_to_insert_to_pd_cspace,
         );
         let pd_guard_size =
-            kernel_config.cap_address_bits - PD_CAP_BITS as u64 - PD_ROOT_CAP_BITS as u64;
+            kernel_config.cap_address_bits - pd_cap_bits as u64 - PD_ROOT_CAP_BITS as u64;
         let pd_cnode_cap = capdl_util_make_cnode_cap(pd_cnode_obj_id, 0, pd_guard_size as u8);
 
         let pd_root_cnode_obj_id = capdl_util_make_cnode_obj(
@@ -1117,8 +1274,8 @@ pub fn build_capdl_spec(
 
         // We trust that the SDF parsing code have checked for duplicate IDs.
         if channel.end_a.notify {
-            let pd_a_ntfn_cap_idx = PD_BASE_OUTPUT_NOTIFICATION_CAP + channel.end_a.id;
-            let pd_a_ntfn_badge = 1 << channel.end_b.id;
+            let pd_a_ntfn_cap_idx = output_notification_cap_idx(&channel.end_a);
+            let pd_a_ntfn_badge = notification_badge(&channel.end_b);
             let pd_a_ntfn_cap = capdl_util_make_ntfn_cap(pd_b_ntfn_id, true, true, pd_a_ntfn_badge);
             capdl_util_insert_cap_into_cspace(
                 &mut spec_container,
@@ -1129,8 +1286,8 @@ pub fn build_capdl_spec(
         }
 
         if channel.end_b.notify {
-            let pd_b_ntfn_cap_idx = PD_BASE_OUTPUT_NOTIFICATION_CAP + channel.end_b.id;
-            let pd_b_ntfn_badge = 1 << channel.end_a.id;
+            let pd_b_ntfn_cap_idx = output_notification_cap_idx(&channel.end_b);
+            let pd_b_ntfn_badge = notification_badge(&channel.end_a);
             let pd_b_ntfn_cap = capdl_util_make_ntfn_cap(pd_a_ntfn_id, true, true, pd_b_ntfn_badge);
             capdl_util_insert_cap_into_cspace(
                 &mut spec_container,
@@ -1324,3 +1481,147 @@ pub fn build_capdl_spec(
 
     Ok(spec_container)
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::elf::ElfSegmentData;
+    use crate::sel4::ObjectSizes;
+    use serde_json::json;
+    use std::path::PathBuf;
+
+    const AARCH64_KERNEL_CONFIG: Config = Config {
+        arch: Arch::Aarch64,
+        word_size: 64,
+        minimum_page_size: 4096,
+        paddr_user_device_top: 1 << 40,
+        kernel_frame_size: 1 << 12,
+        init_cnode_bits: 12,
+        cap_address_bits: 64,
+        max_num_bootinfo_untypeds: 230,
+        fan_out_limit: 256,
+        hypervisor: true,
+        benchmark: false,
+        num_cores: 1,
+        fpu: true,
+        arm_pa_size_bits: Some(40),
+        arm_smc: None,
+        riscv_pt_levels: None,
+        invocations_labels: json!(null),
+        device_regions: None,
+        normal_regions: None,
+        object_sizes: Some(ObjectSizes {
+            tcb: 11,
+            endpoint: 4,
+            notification: 6,
+            reply: 5,
+            vspace: 12,
+            page_table: 12,
+            huge_page: 30,
+            large_page: 21,
+            small_page: 12,
+            asid_pool: 12,
+            vcpu: Some(12),
+        }),
+    };
+
+    fn test_elf(readonly_data: u8) -> ElfFile {
+        let mut elf = ElfFile::new(PathBuf::from("test.elf"), 64, 0x200000, 183);
+        let text = vec![readonly_data; PageSize::Small as usize];
+        let data = vec![1; PageSize::Small as usize];
+        elf.add_segment(
+            true,
+            false,
+            true,
+            0x200000,
+            ElfSegmentData::RealData(text),
+            None,
+        );
+        elf.add_segment(
+            true,
+            true,
+            false,
+            0x400000,
+            ElfSegmentData::RealData(data),
+            None,
+        );
+        elf
+    }
+
+    fn frame_count(spec_container: &CapDLSpecContainer) -> usize {
+        spec_container
+            .spec
+            .objects
+            .iter()
+            .filter(|named_obj| matches!(named_obj.object, Object::Frame(_)))
+            .count()
+    }
+
+    #[test]
+    fn test_share_readonly_frames() {
+        let config = AARCH64_KERNEL_CONFIG;
+        let elfs = [
+            test_elf(0xaa),
+            test_elf(0xaa),
+            test_elf(0xbb),
+            test_elf(0xaa),
+        ];
+        let mut spec_container = CapDLSpecContainer::new();
+        let mut add_elf = |elf_id: usize, share_group: Option<&str>| {
+            spec_container
+                .add_elf_to_spec(
+                    &config,
+                    &format!("pd{elf_id}"),
+                    CpuCore(0),
+                    elf_id,
+                    &elfs,
+                    false,
+                    share_group,
+                )
+                .unwrap();
+        };
+
+        // Two PDs with the same program image share the read-only frame but not the
+        // writable one.
+        add_elf(0, Some("image"));
+        add_elf(1, Some("image"));
+        // Different read-only content, or a different group, gets its own frame.
+        add_elf(2, Some("image"));
+        add_elf(3, Some("other"));
+
+        assert_eq!(frame_count(&spec_container), 1 + 2 + 2 + 2);
+    }
+
+    #[test]
+    fn test_pd_stack_frames() {
+        let config = AARCH64_KERNEL_CONFIG;
+        let stack_size = 0x40_0000;
+        let stack_bottom = config.pd_stack_bottom(stack_size);
+        let frames = pd_stack_frames(&config, stack_size);
+
+        // Small pages up to the first large page boundary, one large page, then small
+        // pages up to the guard page below the IPC buffer.
+        assert_eq!(stack_bottom, 0xff_ffbf_e000);
+        assert_eq!(frames[0], (stack_bottom, PageSize::Small));
+        assert_eq!(frames[1], (0xff_ffbf_f000, PageSize::Small));
+        assert_eq!(frames[2], (0xff_ffc0_0000, PageSize::Large));
+        assert!(frames[3..]
+            .iter()
+            .all(|(_, page_size)| *page_size == PageSize::Small));
+        assert_eq!(frames.len(), 3 + 0x1fe);
+
+        // The frames cover the stack without gaps
+        let mut vaddr = stack_bottom;
+        for (frame_vaddr, page_size) in &frames {
+            assert_eq!(*frame_vaddr, vaddr);
+            vaddr += *page_size as u64;
+        }
+        assert_eq!(vaddr, config.pd_stack_top());
+
+        // Nothing can be mapped in the page just below the stack
+        assert_eq!(
+            config.pd_map_max_vaddr(stack_size),
+            stack_bottom - PageSize::Small as u64
+        );
+    }
+}
@@ -4,7 +4,7 @@
 // SPDX-License-Identifier: BSD-2-Clause
 //
 
-use crate::capdl::{builder::PD_CAP_SIZE, CapDLNamedObject, CapDLSpecContainer, FrameFill};
+use crate::capdl::{CapDLNamedObject, CapDLSpecContainer, FrameFill};
 use sel4_capdl_initializer_types::{
     cap, object, Cap, CapSlot, CapTableEntry, Object, ObjectId, Rights, Word,
 };
@@ -266,9 +266,9 @@ pub fn capdl_util_insert_cap_into_cspace(
     idx: u32,
     cap: Cap,
 ) {
-    assert!(idx < PD_CAP_SIZE);
     let cspace_obj = spec_container.get_root_object_mut(cspace_obj_id).unwrap();
     if let Object::CNode(cspace_inner_obj) = &mut cspace_obj.object {
+        assert!(idx < 1 << cspace_inner_obj.size_bits);
         cspace_inner_obj.slots.push(capdl_util_make_cte(idx, cap));
     } else {
         unreachable!("capdl_util_insert_cap_into_cspace(): internal bug: got a non CNode object id {} with name '{}'", usize::from(cspace_obj_id), cspace_obj.name.as_ref().unwrap());
@@ -7,6 +7,7 @@ use crate::elf::{ElfFile, ElfSegmentData};
 use crate::sel4::{Arch, Config};
 use crate::uimage::uimage_serialise;
 use crate::util::{mb, round_up, struct_to_bytes};
+use std::borrow::Cow;
 use std::fs::File;
 use std::io::{BufWriter, Write};
 use std::ops::Range;
@@ -304,6 +305,14 @@ fn check_non_overlapping(regions: &Vec<(u64, &[u8])>) {
     }
 }
 
+/// Region data is copied as is.
+const REGION_TYPE_DATA: u64 = 1;
+/// Region data is a raw DEFLATE stream that the loader decompresses.
+const REGION_TYPE_DEFLATE: u64 = 3;
+
+/// Regions smaller than this are not worth padding the image for to avoid copying them.
+const IN_PLACE_MIN_SIZE: u64 = mb(1);
+
 #[repr(C)]
 struct LoaderRegion64 {
     load_addr: u64,
@@ -312,6 +321,116 @@ struct LoaderRegion64 {
     r#type: u64,
 }
 
+/// Returns the loader region for `data` to be loaded at `addr`, along with the data to
+/// store in the image for it. The offset of the region is left for the caller to fill in.
+fn region_payload(addr: u64, data: &[u8], compress: bool) -> (LoaderRegion64, Cow<'_, [u8]>) {
+    // Regions are only stored compressed if that makes them smaller.
+    let compressed = compress
+        .then(|| miniz_oxide::deflate::compress_to_vec(data, 6))
+        .filter(|compressed| compressed.len() < data.len());
+    let (region_type, payload) = match compressed {
+        Some(compressed) => (REGION_TYPE_DEFLATE, Cow::Owned(compressed)),
+        None => (REGION_TYPE_DATA, Cow::Borrowed(data)),
+    };
+
+    (
+        LoaderRegion64 {
+            load_addr: addr,
+            size: data.len() as u64,
+            offset: 0,
+            r#type: region_type,
+        },
+        payload,
+    )
+}
+
+/// Whether a region that the loader copies would overwrite the data of another region in
+/// the image. Regions may be copied in any order (and concurrently), so every pair is checked.
+fn layout_clobbers_sources(layout: &[(LoaderRegion64, Cow<[u8]>)], payload_vaddr: u64) -> bool {
+    layout.iter().enumerate().any(|(i, (region, _))| {
+        let in_place =
+            region.r#type == REGION_TYPE_DATA && payload_vaddr + region.offset == region.load_addr;
+        let dest_end = region.load_addr + region.size;
+        !in_place
+            && layout.iter().enumerate().any(|(j, (other, data))| {
+                let source = payload_vaddr + other.offset;
+                i != j && region.load_addr < source + data.len() as u64 && source < dest_end
+            })
+    })
+}
+
+/// Lay out the data of `regions` in the image, where it starts at `payload_vaddr` if the
+/// image is loaded at the loader's link address.
+///
+/// Regions are stored one after the other. If `in_place_regions` is set, large regions are
+/// instead placed at their load address so that the loader does not have to copy them.
+/// These go after all other regions, in address order, with padding in between. Large
+/// regions that would overlap what comes before them, or that would need more padding
+/// than the copy it saves (the size of the region), are stored after the in-place ones.
+/// This bounds the padding by the size of the regions placed in place.
+/// If that layout would make copying one region overwrite the data of another, the plain
+/// layout is used instead.
+fn layout_regions<'a>(
+    regions: &[(u64, &'a [u8])],
+    payload_vaddr: u64,
+    compress_regions: bool,
+    in_place_regions: bool,
+) -> Vec<(LoaderRegion64, Cow<'a, [u8]>)> {
+    let (mut in_place, copied): (Vec<(u64, &[u8])>, Vec<_>) = regions
+        .iter()
+        .partition(|(_, data)| in_place_regions && data.len() as u64 >= IN_PLACE_MIN_SIZE);
+    in_place.sort_by_key(|(addr, _)| *addr);
+
+    let mut layout: Vec<_> = copied
+        .iter()
+        .map(|(addr, data)| region_payload(*addr, data, compress_regions))
+        .collect();
+    let num_copied = layout.len();
+    let mut offset = 0;
+    for (region, data) in &mut layout {
+        region.offset = offset;
+        offset += data.len() as u64;
+    }
+
+    if in_place.is_empty() {
+        return layout;
+    }
+
+    let mut overlapping = Vec::new();
+    for (addr, data) in &in_place {
+        if *addr >= payload_vaddr + offset && addr - (payload_vaddr + offset) <= data.len() as u64 {
+            let (mut region, data) = region_payload(*addr, data, false);
+            region.offset = addr - payload_vaddr;
+            offset = region.offset + data.len() as u64;
+            layout.push((region, data));
+        } else {
+            overlapping.push((*addr, *data));
+        }
+    }
+    for (addr, data) in overlapping {
+        let (mut region, data) = region_payload(addr, data, false);
+        region.offset = offset;
+        offset += data.len() as u64;
+        layout.push((region, data));
+    }
+
+    if !layout_clobbers_sources(&layout, payload_vaddr) {
+        return layout;
+    }
+
+    // Fall back to storing the large regions after the others like any other region
+    layout.truncate(num_copied);
+    offset = layout.iter().map(|(_, data)| data.len() as u64).sum();
+    for (addr, data) in in_place {
+        let (mut region, data) = region_payload(addr, data, compress_regions);
+        region.offset = offset;
+        offset += data.len() as u64;
+        layout.push((region, data));
+    }
+
+    layout
+}
+
 #[repr(C)]
 struct LoaderHeader64 {
     magic: u64,
@@ -329,7 +448,7 @@ pub struct Loader<'a> {
     loader_image: Vec<u8>,
     header: LoaderHeader64,
     region_metadata: Vec<LoaderRegion64>,
-    regions: Vec<(u64, &'a [u8])>,
+    region_data: Vec<Cow<'a, [u8]>>,
     word_size: usize,
     elf_machine: u16,
     entry: u64,
@@ -343,6 +462,8 @@ impl<'a> Loader<'a> {
         initial_task_elf: &'a ElfFile,
         initial_task_phy_base: u64,
         initial_task_vaddr_range: &Range<u64>,
+        compress_regions: bool,
+        in_place_regions: bool,
     ) -> Loader<'a> {
         if config.arch == Arch::X86_64 {
             unreachable!("internal error: x86_64 does not support creating a loader image");
@@ -482,22 +603,24 @@ impl<'a> Loader<'a> {
         all_regions_with_loader.push((image_vaddr, &loader_image));
         check_non_overlapping(&all_regions_with_loader);
 
-        let mut region_metadata = Vec::new();
-        let mut offset: u64 = 0;
-        for (addr, data) in &regions {
-            region_metadata.push(LoaderRegion64 {
-                load_addr: *addr,
-                size: data.len() as u64,
-                offset,
-                r#type: 1,
-            });
-            offset += data.len() as u64;
-        }
+        let payload_vaddr = image_vaddr
+            + loader_image.len() as u64
+            + std::mem::size_of::<LoaderHeader64>() as u64
+            + (regions.len() * std::mem::size_of::<LoaderRegion64>()) as u64;
+        let (region_metadata, region_data): (Vec<_>, Vec<_>) =
+            layout_regions(&regions, payload_vaddr, compress_regions, in_place_regions)
+                .into_iter()
+                .unzip();
+        let payload_size = region_metadata
+            .iter()
+            .zip(&region_data)
+            .map(|(region, data)| region.offset + data.len() as u64)
+            .max()
+            .unwrap_or(0);
 
         let size = std::mem::size_of::<LoaderHeader64>() as u64
-            + region_metadata.iter().fold(0_u64, |acc, x| {
-                acc + x.size + std::mem::size_of::<LoaderRegion64>() as u64
-            });
+            + (region_metadata.len() * std::mem::size_of::<LoaderRegion64>()) as u64
+            + payload_size;
 
         let header = LoaderHeader64 {
             magic,
@@ -515,7 +638,7 @@ impl<'a> Loader<'a> {
             loader_image,
             header,
             region_metadata,
-            regions,
+            region_data,
             word_size: kernel_elf.word_size,
             elf_machine: kernel_elf.machine,
             entry: loader_elf.entry,
@@ -534,8 +657,10 @@ impl<'a> Loader<'a> {
             let region_metadata_bytes = unsafe { struct_to_bytes(region) };
             bytes.extend_from_slice(region_metadata_bytes);
         }
-        // Now we can copy all the region data
-        for (_, data) in &self.regions {
+        // Now we can copy all the region data, padding up to regions placed at their load address
+        let payload_start = bytes.len();
+        for (region, data) in self.region_metadata.iter().zip(&self.region_data) {
+            bytes.resize(payload_start + region.offset as usize, 0);
             bytes.extend_from_slice(data);
         }
 
@@ -912,3 +1037,109 @@ impl<'a> Loader<'a> {
         ]
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const PAYLOAD_VADDR: u64 = 0x1000_0000;
+
+    fn offsets(layout: &[(LoaderRegion64, Cow<[u8]>)]) -> Vec<(u64, u64)> {
+        layout
+            .iter()
+            .map(|(region, _)| (region.load_addr, region.offset))
+            .collect()
+    }
+
+    #[test]
+    fn test_layout_plain() {
+        let small = vec![1u8; 16];
+        let large = vec![2u8; mb(1) as usize];
+        let regions = [(0x1020_0000, large.as_slice()), (0x1030_0000, &small)];
+
+        let layout = layout_regions(&regions, PAYLOAD_VADDR, false, false);
+        assert_eq!(
+            offsets(&layout),
+            vec![(0x1020_0000, 0), (0x1030_0000, mb(1))]
+        );
+    }
+
+    #[test]
+    fn test_layout_in_place() {
+        let small = vec![1u8; 16];
+        let large = vec![2u8; mb(2) as usize];
+        let below = vec![3u8; mb(1) as usize];
+        let regions = [
+            (0x1020_0000, large.as_slice()),
+            (0x1050_0000, &small),
+            (0x0800_0000, &below),
+        ];
+
+        // The region below the payload cannot be placed at its load address
+        let layout = layout_regions(&regions, PAYLOAD_VADDR, false, true);
+        assert_eq!(
+            offsets(&layout),
+            vec![
+                (0x1050_0000, 0),
+                (0x1020_0000, 0x20_0000),
+                (0x0800_0000, 0x40_0000)
+            ]
+        );
+        assert!(layout
+            .iter()
+            .all(|(region, _)| region.r#type == REGION_TYPE_DATA));
+    }
+
+    #[test]
+    fn test_layout_in_place_clobbers_source() {
+        let small = vec![1u8; 16];
+        let large = vec![2u8; mb(2) as usize];
+        let below = vec![3u8; mb(1) as usize];
+        // Copying the small region would overwrite the data of the region that is
+        // stored after the one placed at its load address.
+        let regions = [
+            (0x1020_0000, large.as_slice()),
+            (0x1040_1000, &small),
+            (0x0800_0000, &below),
+        ];
+
+        let layout = layout_regions(&regions, PAYLOAD_VADDR, false, true);
+        assert_eq!(
+            offsets(&layout),
+            vec![
+                (0x1040_1000, 0),
+                (0x0800_0000, 16),
+                (0x1020_0000, 16 + mb(1))
+            ]
+        );
+    }
+
+    #[test]
+    fn test_layout_in_place_padding_limit() {
+        let small = vec![1u8; 16];
+        let near = vec![2u8; mb(1) as usize];
+        let far = vec![3u8; mb(1) as usize];
+        // Placing the far region at its load address would pad the image by 300 MiB
+        // to avoid copying 1 MiB, so it is stored after the others instead.
+        let regions = [
+            (0x1000_1000, near.as_slice()),
+            (PAYLOAD_VADDR + mb(300), &far),
+            (0x0800_0000, &small),
+        ];
+
+        let layout = layout_regions(&regions, PAYLOAD_VADDR, false, true);
+        assert_eq!(
+            offsets(&layout),
+            vec![
+                (0x0800_0000, 0),
+                (0x1000_1000, 0x1000),
+                (PAYLOAD_VADDR + mb(300), 0x1000 + mb(1))
+            ]
+        );
+        let size = layout
+            .iter()
+            .map(|(region, data)| region.offset + data.len() as u64)
+            .max();
+        assert_eq!(size, Some(0x1000 + mb(2)));
+    }
+}
@@ -675,6 +675,8 @@ fn main() -> Result<(), String> {
                         &capdl_initialiser.elf,
                         capdl_initialiser.phys_base.unwrap(),
                         &initialiser_vaddr_range,
+                        args.compress_regions,
+                        args.in_place_regions,
                     );
 
                     match image_output_type {
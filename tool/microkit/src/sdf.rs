@@ -38,6 +38,16 @@ use std::path::{Path, PathBuf};
 const PD_MAX_ID: u64 = 61;
 const VCPU_MAX_ID: u64 = PD_MAX_ID;
 
+/// Protection domains with channel groups can additionally use the IDs from
+/// CHANNEL_GROUP_MIN_ID up to CHANNEL_GROUP_MAX_ID for receiving notifications.
+/// These do not have their own badge bit, instead the sender sets the bit of the
+/// ID in a two-level bitmap shared with the receiver and signals the badge bit of
+/// CHANNEL_GROUP_ID. This must be kept in sync with `microkit.h`.
+pub const CHANNEL_GROUP_MIN_ID: u64 = 64;
+const CHANNEL_GROUP_COUNT: u64 = 16;
+const CHANNEL_GROUP_MAX_ID: u64 = CHANNEL_GROUP_MIN_ID + CHANNEL_GROUP_COUNT * 64 - 1;
+pub const CHANNEL_GROUP_ID: u64 = PD_MAX_ID;
+
 /// This is the maximum slot allowed for cap maps. This can change if you wish,
 /// but also update the MICROKIT_MAX_USER_CAPS define in `microkit.h`.
 const CAP_MAP_MAX_SLOT: u64 = 128;
@@ -54,6 +64,10 @@ pub const PD_DEFAULT_STACK_SIZE: u64 = 0x2000;
 const PD_MIN_STACK_SIZE: u64 = 0x1000;
 const PD_MAX_STACK_SIZE: u64 = 1024 * 1024 * 16;
 
+/// Size of the memory region holding the handler instrumentation of a PD.
+/// This must be kept in sync with `MICROKIT_INSTRUMENTATION_SIZE` in `microkit.h`.
+const PD_INSTRUMENTATION_SIZE: u64 = 0x7000;
+
 /// Maximum values for PCI bus, device, function numbers. Inclusive.
 const PCI_BUS_MAX: i64 = (1 << 8) - 1;
 const PCI_DEV_MAX: i64 = (1 << 5) - 1;
@@ -244,12 +258,33 @@ pub struct ChannelEnd {
     pub notify: bool,
     pub pp: bool,
     pub setvar_id: Option<String>,
+    /// Where the notification coalescing flags are mapped, for channels
+    /// with coalescing enabled.
+    pub coalesce_vaddr: Option<u64>,
+    /// Where the channel groups bitmap of the other end is mapped, for
+    /// ends that notify a channel group ID.
+    pub group_vaddr: Option<u64>,
+    /// Where the PPC buffer is mapped, for channels with one.
+    pub pp_buffer_vaddr: Option<u64>,
+    pub setvar_pp_buffer: Option<String>,
+}
+
+/// Memory region shared by both ends of a channel used for protected
+/// procedure calls, for data that does not fit in the message registers.
+#[derive(Debug)]
+pub struct PpBuffer {
+    pub mr: String,
+    pub size: u64,
 }
 
 #[derive(Debug)]
 pub struct Channel {
     pub end_a: ChannelEnd,
     pub end_b: ChannelEnd,
+    /// Name of the tool created memory region holding the notification
+    /// coalescing flags, for channels with coalescing enabled.
+    pub coalesce_mr: Option<String>,
+    pub pp_buffer: Option<PpBuffer>,
 }
 
 #[derive(Debug, Copy, Clone, PartialEq, Eq, PartialOrd, Ord)]
@@ -261,6 +296,26 @@ impl Display for CpuCore {
     }
 }
 
+/// Handler instrumentation for a PD, which the tool creates a memory region for.
+/// The region can optionally be mapped read-only into an observer PD.
+#[derive(Debug, PartialEq, Eq)]
+pub struct Instrumentation {
+    pub vaddr: u64,
+    observer: Option<String>,
+    observer_vaddr: Option<u64>,
+    observer_setvar_vaddr: Option<String>,
+    text_pos: roxmltree::TextPos,
+}
+
+/// A heap for a PD, which the tool creates a memory region for.
+#[derive(Debug, PartialEq, Eq)]
+pub struct Heap {
+    pub vaddr: u64,
+    pub size: u64,
+    /// Only set if specified by the user, otherwise the tool picks the page size.
+    page_size: Option<u64>,
+}
+
 #[derive(Debug, PartialEq, Eq)]
 pub struct ProtectionDomain {
     /// Only populated for child protection domains
@@ -270,11 +325,17 @@ pub struct ProtectionDomain {
     pub budget: u64,
     pub period: u64,
     pub passive: bool,
+    /// Number of times the event loop polls for an event before blocking.
+    pub poll_budget: u64,
     pub stack_size: u64,
     pub smc: bool,
     pub cpu: CpuCore,
     pub program_image: PathBuf,
     pub program_image_for_symbols: Option<PathBuf>,
+    /// Whether the tool may map the program image's segments with large pages.
+    pub elf_large_pages: bool,
+    /// Whether read-only frames are shared with other PDs using the same program image.
+    pub share_readonly: bool,
     /// Enable FPU for this PD.
     pub fpu: bool,
     pub maps: Vec<SysMap>,
@@ -282,6 +343,12 @@ pub struct ProtectionDomain {
     pub ioports: Vec<IOPort>,
     pub setvars: Vec<SysSetVar>,
     pub cap_maps: Vec<CapMap>,
+    pub instrumentation: Option<Instrumentation>,
+    /// Where the channel groups bitmap is mapped, if the PD has channel groups.
+    pub channel_groups_vaddr: Option<u64>,
+    /// Filled in when parsing the rings of the system.
+    pub log_ring: Option<LogRing>,
+    pub heap: Option<Heap>,
     pub virtual_machine: Option<VirtualMachine>,
     /// Only used when parsing child PDs. All elements will be removed
     /// once we flatten each PD and its children into one list.
@@ -506,6 +573,7 @@ impl ProtectionDomain {
             "budget",
             "period",
             "passive",
+            "poll_budget",
             "stack_size",
             // The SMC field is only available in certain configurations
             // but we do the error-checking further down.
@@ -563,6 +631,19 @@ impl ProtectionDomain {
             false
         };
 
+        let poll_budget = if let Some(xml_poll_budget) = node.attribute("poll_budget") {
+            sdf_parse_number(xml_poll_budget, node)?
+        } else {
+            0
+        };
+        if passive && poll_budget != 0 {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                "poll_budget cannot be used with passive protection domains".to_string(),
+            ));
+        }
+
         let stack_size = if let Some(xml_stack_size) = node.attribute("stack_size") {
             sdf_parse_number(xml_stack_size, node)?
         } else {
@@ -647,8 +728,13 @@ impl ProtectionDomain {
 
         let mut program_image = None;
         let mut program_image_for_symbols = None;
+        let mut elf_large_pages = true;
+        let mut share_readonly = false;
         let mut virtual_machine = None;
         let mut cspace = None;
+        let mut instrumentation = None;
+        let mut channel_groups_vaddr = None;
+        let mut heap = None;
 
         // Default to minimum priority
         let priority = if let Some(xml_priority) = node.attribute("priority") {
@@ -688,7 +774,11 @@ impl ProtectionDomain {
 
             match child.tag_name().name() {
                 "program_image" => {
-                    check_attributes(xml_sdf, &child, &["path", "path_for_symbols"])?;
+                    check_attributes(
+                        xml_sdf,
+                        &child,
+                        &["path", "path_for_symbols", "large_pages", "share_readonly"],
+                    )?;
                     if program_image.is_some() {
                         return Err(value_error(
                             xml_sdf,
@@ -702,6 +792,30 @@ impl ProtectionDomain {
 
                     program_image_for_symbols =
                         child.attribute("path_for_symbols").map(PathBuf::from);
+
+                    elf_large_pages = child
+                        .attribute("large_pages")
+                        .map(str_to_bool)
+                        .unwrap_or(Some(true))
+                        .ok_or_else(|| {
+                            value_error(
+                                xml_sdf,
+                                &child,
+                                "large_pages must be 'true' or 'false'".to_string(),
+                            )
+                        })?;
+
+                    share_readonly = child
+                        .attribute("share_readonly")
+                        .map(str_to_bool)
+                        .unwrap_or(Some(false))
+                        .ok_or_else(|| {
+                            value_error(
+                                xml_sdf,
+                                &child,
+                                "share_readonly must be 'true' or 'false'".to_string(),
+                            )
+                        })?;
                 }
                 "map" => {
                     let map_max_vaddr = config.pd_map_max_vaddr(stack_size);
@@ -1178,6 +1292,181 @@ impl ProtectionDomain {
 
                     cspace = Some(CSpace::from_xml(xml_sdf, &child)?);
                 }
+                "channel_groups" => {
+                    check_attributes(xml_sdf, &child, &["vaddr", "setvar_vaddr"])?;
+                    if channel_groups_vaddr.is_some() {
+                        return Err(value_error(
+                            xml_sdf,
+                            node,
+                            "channel_groups must only be specified once".to_string(),
+                        ));
+                    }
+
+                    let vaddr =
+                        sdf_parse_number(checked_lookup(xml_sdf, &child, "vaddr")?, &child)?;
+                    let max_vaddr = config.pd_map_max_vaddr(stack_size);
+                    if vaddr >= max_vaddr {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            format!("vaddr (0x{vaddr:x}) must be less than 0x{max_vaddr:x}"),
+                        ));
+                    }
+
+                    if let Some(setvar_vaddr) = child.attribute("setvar_vaddr") {
+                        let setvar = SysSetVar {
+                            symbol: setvar_vaddr.to_string(),
+                            kind: SysSetVarKind::Vaddr { address: vaddr },
+                        };
+                        checked_add_setvar(&mut setvars, setvar, xml_sdf, &child)?;
+                    }
+
+                    channel_groups_vaddr = Some(vaddr);
+                }
+                "heap" => {
+                    check_attributes(
+                        xml_sdf,
+                        &child,
+                        &["vaddr", "size", "page_size", "setvar_vaddr", "setvar_size"],
+                    )?;
+                    if heap.is_some() {
+                        return Err(value_error(
+                            xml_sdf,
+                            node,
+                            "heap must only be specified once".to_string(),
+                        ));
+                    }
+
+                    let page_size = match child.attribute("page_size") {
+                        Some(xml_page_size) => {
+                            let page_size = sdf_parse_number(xml_page_size, &child)?;
+                            if !config.page_sizes().contains(&page_size) {
+                                return Err(value_error(
+                                    xml_sdf,
+                                    &child,
+                                    format!("page size 0x{page_size:x} not supported"),
+                                ));
+                            }
+                            Some(page_size)
+                        }
+                        None => None,
+                    };
+
+                    let size = sdf_parse_number(checked_lookup(xml_sdf, &child, "size")?, &child)?;
+                    if size == 0
+                        || !size.is_multiple_of(page_size.unwrap_or(config.page_sizes()[0]))
+                    {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            "size is not a multiple of the page size".to_string(),
+                        ));
+                    }
+
+                    let vaddr =
+                        sdf_parse_number(checked_lookup(xml_sdf, &child, "vaddr")?, &child)?;
+                    let max_vaddr = config.pd_map_max_vaddr(stack_size);
+                    if vaddr >= max_vaddr {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            format!("vaddr (0x{vaddr:x}) must be less than 0x{max_vaddr:x}"),
+                        ));
+                    }
+
+                    if let Some(setvar_vaddr) = child.attribute("setvar_vaddr") {
+                        let setvar = SysSetVar {
+                            symbol: setvar_vaddr.to_string(),
+                            kind: SysSetVarKind::Vaddr { address: vaddr },
+                        };
+                        checked_add_setvar(&mut setvars, setvar, xml_sdf, &child)?;
+                    }
+                    if let Some(setvar_size) = child.attribute("setvar_size") {
+                        let setvar = SysSetVar {
+                            symbol: setvar_size.to_string(),
+                            kind: SysSetVarKind::Size {
+                                mr: format!("heap_{name}"),
+                            },
+                        };
+                        checked_add_setvar(&mut setvars, setvar, xml_sdf, &child)?;
+                    }
+
+                    heap = Some(Heap {
+                        vaddr,
+                        size,
+                        page_size,
+                    });
+                }
+                "instrumentation" => {
+                    check_attributes(
+                        xml_sdf,
+                        &child,
+                        &[
+                            "vaddr",
+                            "setvar_vaddr",
+                            "observer",
+                            "observer_vaddr",
+                            "observer_setvar_vaddr",
+                        ],
+                    )?;
+                    if instrumentation.is_some() {
+                        return Err(value_error(
+                            xml_sdf,
+                            node,
+                            "instrumentation must only be specified once".to_string(),
+                        ));
+                    }
+
+                    let vaddr =
+                        sdf_parse_number(checked_lookup(xml_sdf, &child, "vaddr")?, &child)?;
+                    let max_vaddr = config.pd_map_max_vaddr(stack_size);
+                    if vaddr >= max_vaddr {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            format!("vaddr (0x{vaddr:x}) must be less than 0x{max_vaddr:x}"),
+                        ));
+                    }
+
+                    if let Some(setvar_vaddr) = child.attribute("setvar_vaddr") {
+                        let setvar = SysSetVar {
+                            symbol: setvar_vaddr.to_string(),
+                            kind: SysSetVarKind::Vaddr { address: vaddr },
+                        };
+                        checked_add_setvar(&mut setvars, setvar, xml_sdf, &child)?;
+                    }
+
+                    let observer = child.attribute("observer").map(ToOwned::to_owned);
+                    let observer_vaddr = match child.attribute("observer_vaddr") {
+                        Some(xml_vaddr) => Some(sdf_parse_number(xml_vaddr, &child)?),
+                        None => None,
+                    };
+                    if observer.is_some() != observer_vaddr.is_some() {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            "observer and observer_vaddr must be specified together".to_string(),
+                        ));
+                    }
+                    let observer_setvar_vaddr = child
+                        .attribute("observer_setvar_vaddr")
+                        .map(ToOwned::to_owned);
+                    if observer.is_none() && observer_setvar_vaddr.is_some() {
+                        return Err(value_error(
+                            xml_sdf,
+                            &child,
+                            "observer_setvar_vaddr requires an observer".to_string(),
+                        ));
+                    }
+
+                    instrumentation = Some(Instrumentation {
+                        vaddr,
+                        observer,
+                        observer_vaddr,
+                        observer_setvar_vaddr,
+                        text_pos: xml_sdf.doc.text_pos_at(child.range().start),
+                    });
+                }
                 _ => {
                     let pos = xml_sdf.doc.text_pos_at(child.range().start);
                     return Err(format!(
@@ -1206,17 +1495,24 @@ impl ProtectionDomain {
             budget,
             period,
             passive,
+            poll_budget,
             stack_size,
             smc,
             cpu,
             program_image: program_image.unwrap(),
             program_image_for_symbols,
+            elf_large_pages,
+            share_readonly,
             fpu,
             maps,
             irqs,
             ioports,
             setvars,
             cap_maps: cspace.map(|cspace| cspace.cap_maps).unwrap_or_default(),
+            instrumentation,
+            channel_groups_vaddr,
+            log_ring: None,
+            heap,
             child_pds,
             virtual_machine,
             has_children,
@@ -1482,6 +1778,29 @@ impl SysMemoryRegion {
         }
     }
 
+    /// Create a memory region on behalf of an SDF element other than `memory_region`,
+    /// for example the memory backing a `ring`. The page size is left to be optimised
+    /// based on where the region ends up being mapped.
+    fn new_tool_created(
+        config: &Config,
+        name: &str,
+        size: u64,
+        text_pos: roxmltree::TextPos,
+    ) -> SysMemoryRegion {
+        let page_size = config.page_sizes()[0];
+        SysMemoryRegion {
+            name: name.to_string(),
+            size,
+            page_size: page_size.into(),
+            page_size_specified_by_user: false,
+            page_count: size / page_size,
+            phys_addr: SysMemoryRegionPaddr::Unspecified,
+            text_pos: Some(text_pos),
+            kind: SysMemoryRegionKind::User,
+            prefill_bytes: None,
+        }
+    }
+
     fn from_xml(
         config: &Config,
         xml_sdf: &XmlSystemDescription,
@@ -1584,7 +1903,13 @@ impl SysMemoryRegion {
 }
 
 impl ChannelEnd {
+    /// Whether this end uses one of the IDs reserved for channel groups.
+    pub fn is_group_id(&self) -> bool {
+        self.id >= CHANNEL_GROUP_MIN_ID
+    }
+
     fn from_xml<'a>(
+        config: &Config,
         xml_sdf: &'a XmlSystemDescription,
         node: &'a roxmltree::Node,
         pds: &[ProtectionDomain],
@@ -1599,16 +1924,41 @@ impl ChannelEnd {
             ));
         }
 
-        check_attributes(xml_sdf, node, &["pd", "id", "pp", "notify", "setvar_id"])?;
+        check_attributes(
+            xml_sdf,
+            node,
+            &[
+                "pd",
+                "id",
+                "pp",
+                "notify",
+                "setvar_id",
+                "coalesce_vaddr",
+                "group_vaddr",
+                "pp_buffer_vaddr",
+                "setvar_pp_buffer",
+            ],
+        )?;
         let end_pd = checked_lookup(xml_sdf, node, "pd")?;
         let end_id = checked_lookup(xml_sdf, node, "id")?.parse::<i64>().unwrap();
 
-        if end_id > PD_MAX_ID as i64 {
-            return Err(value_error(
-                xml_sdf,
-                node,
-                format!("id must be < {}", PD_MAX_ID + 1),
-            ));
+        let has_channel_groups = pds
+            .iter()
+            .any(|pd| pd.name == end_pd && pd.channel_groups_vaddr.is_some());
+        let is_group_id =
+            (CHANNEL_GROUP_MIN_ID as i64..=CHANNEL_GROUP_MAX_ID as i64).contains(&end_id);
+        if end_id > PD_MAX_ID as i64 && !(has_channel_groups && is_group_id) {
+            let msg = if has_channel_groups {
+                format!(
+                    "id must be < {}, or between {} and {} for channel groups",
+                    PD_MAX_ID + 1,
+                    CHANNEL_GROUP_MIN_ID,
+                    CHANNEL_GROUP_MAX_ID
+                )
+            } else {
+                format!("id must be < {}", PD_MAX_ID + 1)
+            };
+            return Err(value_error(xml_sdf, node, msg));
         }
 
         if end_id < 0 {
@@ -1637,12 +1987,46 @@ impl ChannelEnd {
 
         if let Some(pd_idx) = pds.iter().position(|pd| pd.name == end_pd) {
             let setvar_id = node.attribute("setvar_id").map(ToOwned::to_owned);
+
+            let max_vaddr = config.pd_map_max_vaddr(pds[pd_idx].stack_size);
+            let parse_vaddr = |attr: &str| -> Result<Option<u64>, String> {
+                let Some(xml_vaddr) = node.attribute(attr) else {
+                    return Ok(None);
+                };
+                let vaddr = sdf_parse_number(xml_vaddr, node)?;
+                if vaddr >= max_vaddr {
+                    return Err(value_error(
+                        xml_sdf,
+                        node,
+                        format!("{attr} (0x{vaddr:x}) must be less than 0x{max_vaddr:x}"),
+                    ));
+                }
+                Ok(Some(vaddr))
+            };
+
+            let coalesce_vaddr = parse_vaddr("coalesce_vaddr")?;
+            let group_vaddr = parse_vaddr("group_vaddr")?;
+            let pp_buffer_vaddr = parse_vaddr("pp_buffer_vaddr")?;
+
+            let setvar_pp_buffer = node.attribute("setvar_pp_buffer").map(ToOwned::to_owned);
+            if setvar_pp_buffer.is_some() && pp_buffer_vaddr.is_none() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "setvar_pp_buffer requires pp_buffer_vaddr".to_string(),
+                ));
+            }
+
             Ok(ChannelEnd {
                 pd: pd_idx,
                 id: end_id.try_into().unwrap(),
                 notify,
                 pp,
                 setvar_id,
+                coalesce_vaddr,
+                group_vaddr,
+                pp_buffer_vaddr,
+                setvar_pp_buffer,
             })
         } else {
             Err(value_error(
@@ -1659,16 +2043,29 @@ impl Channel {
     /// with all the Protection Domains that could potentially be connected with
     /// the channel.
     fn from_xml<'a>(
+        config: &Config,
         xml_sdf: &'a XmlSystemDescription,
         node: &'a roxmltree::Node,
         pds: &[ProtectionDomain],
     ) -> Result<Channel, String> {
-        check_attributes(xml_sdf, node, &[])?;
+        check_attributes(xml_sdf, node, &["coalesce", "pp_buffer_size"])?;
+
+        let coalesce = node
+            .attribute("coalesce")
+            .map(str_to_bool)
+            .unwrap_or(Some(false))
+            .ok_or_else(|| {
+                value_error(
+                    xml_sdf,
+                    node,
+                    "coalesce must be 'true' or 'false'".to_string(),
+                )
+            })?;
 
         let [ref end_a, ref end_b] = node
             .children()
             .filter(|child| child.is_element())
-            .map(|node| ChannelEnd::from_xml(xml_sdf, &node, pds))
+            .map(|node| ChannelEnd::from_xml(config, xml_sdf, &node, pds))
             .collect::<Result<Vec<_>, _>>()?[..]
         else {
             return Err(value_error(
@@ -1686,9 +2083,323 @@ impl Channel {
             ));
         }
 
+        for (end, other) in [(end_a, end_b), (end_b, end_a)] {
+            if end.is_group_id() && (end.pp || other.pp) {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "channel group ids cannot be used on channels with pp".to_string(),
+                ));
+            }
+            if end.is_group_id() && other.is_group_id() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "channel group ids cannot be used on both ends".to_string(),
+                ));
+            }
+            let notifies_group = end.notify && other.is_group_id();
+            if notifies_group && end.group_vaddr.is_none() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "group_vaddr must be specified on ends that notify a channel group id"
+                        .to_string(),
+                ));
+            }
+            if !notifies_group && end.group_vaddr.is_some() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "group_vaddr must only be specified on ends that notify a channel group id"
+                        .to_string(),
+                ));
+            }
+        }
+
+        let coalesce_vaddrs = [end_a.coalesce_vaddr, end_b.coalesce_vaddr];
+        let coalesce_mr = if coalesce {
+            if coalesce_vaddrs.iter().any(Option::is_none) {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "coalesce_vaddr must be specified on both ends when coalesce is 'true'"
+                        .to_string(),
+                ));
+            }
+            if end_a.pp || end_b.pp {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "coalesce cannot be used on channels with pp".to_string(),
+                ));
+            }
+            if end_a.is_group_id() || end_b.is_group_id() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "coalesce cannot be used with channel group ids".to_string(),
+                ));
+            }
+            Some(format!(
+                "coalesce_{}_{}_{}_{}",
+                pds[end_a.pd].name, end_a.id, pds[end_b.pd].name, end_b.id
+            ))
+        } else {
+            if coalesce_vaddrs.iter().any(Option::is_some) {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    "coalesce_vaddr must only be specified when coalesce is 'true'".to_string(),
+                ));
+            }
+            None
+        };
+
+        let pp_buffer_vaddrs = [end_a.pp_buffer_vaddr, end_b.pp_buffer_vaddr];
+        let pp_buffer = match node.attribute("pp_buffer_size") {
+            Some(xml_size) => {
+                let size = sdf_parse_number(xml_size, node)?;
+                if !end_a.pp && !end_b.pp {
+                    return Err(value_error(
+                        xml_sdf,
+                        node,
+                        "pp_buffer_size can only be used on channels with pp".to_string(),
+                    ));
+                }
+                if size == 0 || size % config.page_sizes()[0] != 0 {
+                    return Err(value_error(
+                        xml_sdf,
+                        node,
+                        "pp_buffer_size must be a non-zero multiple of the page size".to_string(),
+                    ));
+                }
+                if pp_buffer_vaddrs.iter().any(Option::is_none) {
+                    return Err(value_error(
+                        xml_sdf,
+                        node,
+                        "pp_buffer_vaddr must be specified on both ends when pp_buffer_size is specified"
+                            .to_string(),
+                    ));
+                }
+                Some(PpBuffer {
+                    mr: format!(
+                        "pp_buffer_{}_{}_{}_{}",
+                        pds[end_a.pd].name, end_a.id, pds[end_b.pd].name, end_b.id
+                    ),
+                    size,
+                })
+            }
+            None => {
+                if pp_buffer_vaddrs.iter().any(Option::is_some) {
+                    return Err(value_error(
+                        xml_sdf,
+                        node,
+                        "pp_buffer_vaddr must only be specified when pp_buffer_size is specified"
+                            .to_string(),
+                    ));
+                }
+                None
+            }
+        };
+
         Ok(Channel {
             end_a: end_a.clone(),
             end_b: end_b.clone(),
+            coalesce_mr,
+            pp_buffer,
+        })
+    }
+}
+
+/// A single-producer/single-consumer ring buffer between two PDs. Rather than
+/// the user declaring the memory region and channel themselves, the tool creates
+/// the memory region backing the ring, maps it into both PDs and connects them
+/// with a channel.
+#[derive(Debug)]
+struct Ring {
+    mr: SysMemoryRegion,
+    producer: RingEnd,
+    consumer: RingEnd,
+    /// Whether libmicrokit in the producer writes its debug output to this ring.
+    log: bool,
+}
+
+/// The ring that libmicrokit in a PD writes its debug output to, as seen by
+/// that PD.
+#[derive(Debug, PartialEq, Eq)]
+pub struct LogRing {
+    pub vaddr: u64,
+    pub size: u64,
+    pub id: u64,
+}
+
+#[derive(Debug)]
+struct RingEnd {
+    pd: usize,
+    id: u64,
+    vaddr: u64,
+    setvar_vaddr: Option<String>,
+    setvar_size: Option<String>,
+    setvar_id: Option<String>,
+    text_pos: roxmltree::TextPos,
+}
+
+impl RingEnd {
+    fn from_xml(
+        config: &Config,
+        xml_sdf: &XmlSystemDescription,
+        node: &roxmltree::Node,
+        pds: &[ProtectionDomain],
+    ) -> Result<RingEnd, String> {
+        check_attributes(
+            xml_sdf,
+            node,
+            &[
+                "pd",
+                "id",
+                "vaddr",
+                "setvar_vaddr",
+                "setvar_size",
+                "setvar_id",
+            ],
+        )?;
+
+        let end_pd = checked_lookup(xml_sdf, node, "pd")?;
+        let Some(pd_idx) = pds.iter().position(|pd| pd.name == end_pd) else {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                format!("invalid PD name '{end_pd}'"),
+            ));
+        };
+
+        let id = sdf_parse_number(checked_lookup(xml_sdf, node, "id")?, node)?;
+        if id > PD_MAX_ID {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                format!("id must be < {}", PD_MAX_ID + 1),
+            ));
+        }
+
+        let vaddr = sdf_parse_number(checked_lookup(xml_sdf, node, "vaddr")?, node)?;
+        let max_vaddr = config.pd_map_max_vaddr(pds[pd_idx].stack_size);
+        if vaddr >= max_vaddr {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                format!("vaddr (0x{vaddr:x}) must be less than 0x{max_vaddr:x}"),
+            ));
+        }
+
+        Ok(RingEnd {
+            pd: pd_idx,
+            id,
+            vaddr,
+            setvar_vaddr: node.attribute("setvar_vaddr").map(ToOwned::to_owned),
+            setvar_size: node.attribute("setvar_size").map(ToOwned::to_owned),
+            setvar_id: node.attribute("setvar_id").map(ToOwned::to_owned),
+            text_pos: xml_sdf.doc.text_pos_at(node.range().start),
+        })
+    }
+
+    fn channel_end(&self) -> ChannelEnd {
+        ChannelEnd {
+            pd: self.pd,
+            id: self.id,
+            notify: true,
+            pp: false,
+            setvar_id: self.setvar_id.clone(),
+            coalesce_vaddr: None,
+            group_vaddr: None,
+            pp_buffer_vaddr: None,
+            setvar_pp_buffer: None,
+        }
+    }
+}
+
+impl Ring {
+    fn from_xml(
+        config: &Config,
+        xml_sdf: &XmlSystemDescription,
+        node: &roxmltree::Node,
+        pds: &[ProtectionDomain],
+    ) -> Result<Ring, String> {
+        check_attributes(xml_sdf, node, &["name", "size", "log"])?;
+
+        let name = checked_lookup(xml_sdf, node, "name")?;
+        let size = sdf_parse_number(checked_lookup(xml_sdf, node, "size")?, node)?;
+        if size == 0 || !size.is_multiple_of(config.page_sizes()[0]) {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                "size is not a multiple of the page size".to_string(),
+            ));
+        }
+
+        let log = node
+            .attribute("log")
+            .map(str_to_bool)
+            .unwrap_or(Some(false))
+            .ok_or_else(|| {
+                value_error(xml_sdf, node, "log must be 'true' or 'false'".to_string())
+            })?;
+
+        let mut producer = None;
+        let mut consumer = None;
+        for child in node.children().filter(|child| child.is_element()) {
+            let end = match child.tag_name().name() {
+                "producer" => &mut producer,
+                "consumer" => &mut consumer,
+                child_name => {
+                    let pos = xml_sdf.doc.text_pos_at(child.range().start);
+                    return Err(format!(
+                        "Error: invalid XML element '{}': {}",
+                        child_name,
+                        loc_string(xml_sdf, pos)
+                    ));
+                }
+            };
+
+            if end.is_some() {
+                return Err(value_error(
+                    xml_sdf,
+                    node,
+                    format!("{} must only be specified once", child.tag_name().name()),
+                ));
+            }
+            *end = Some(RingEnd::from_xml(config, xml_sdf, &child, pds)?);
+        }
+
+        let (Some(producer), Some(consumer)) = (producer, consumer) else {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                "exactly one producer and one consumer must be specified".to_string(),
+            ));
+        };
+
+        if producer.pd == consumer.pd {
+            return Err(value_error(
+                xml_sdf,
+                node,
+                "producer and consumer must be different protection domains".to_string(),
+            ));
+        }
+
+        let mr = SysMemoryRegion::new_tool_created(
+            config,
+            name,
+            size,
+            xml_sdf.doc.text_pos_at(node.range().start),
+        );
+
+        Ok(Ring {
+            mr,
+            producer,
+            consumer,
+            log,
         })
     }
 }
@@ -1710,6 +2421,7 @@ fn check_maps(
     mrs: &[SysMemoryRegion],
     e: &dyn ExecutionContext,
     maps: &[SysMap],
+    max_vaddr: u64,
 ) -> Result<(), String> {
     let mut checked_maps = Vec::with_capacity(maps.len());
     for map in maps {
@@ -1726,6 +2438,18 @@ fn check_maps(
 
                 let map_start = map.vaddr;
                 let map_end = map.vaddr + mr.size;
+                if map_end > max_vaddr {
+                    return Err(format!(
+                        "Error: map for '{}' has virtual address range [0x{:x}..0x{:x}) which extends past 0x{:x} in {} '{}' @ {}",
+                        map.mr,
+                        map_start,
+                        map_end,
+                        max_vaddr,
+                        e.kind(),
+                        e.name(),
+                        loc_string(xml_sdf, pos)
+                    ));
+                }
                 for (name, start, end) in &checked_maps {
                     if !(map_start >= *end || map_end <= *start) {
                         return Err(
@@ -1949,6 +2673,8 @@ pub fn parse(
     // via an index in the list of PDs. This means that we have to parse all PDs first and
     // then parse the channels.
     let mut channel_nodes = Vec::new();
+    // The same applies to rings, which also create a channel.
+    let mut ring_nodes = Vec::new();
 
     for child in system.children() {
         if !child.is_element() {
@@ -1961,6 +2687,7 @@ pub fn parse(
                 root_pds.push(ProtectionDomain::from_xml(config, &xml_sdf, &child, false)?)
             }
             "channel" => channel_nodes.push(child),
+            "ring" => ring_nodes.push(child),
             "memory_region" => mrs.push(SysMemoryRegion::from_xml(
                 config,
                 &xml_sdf,
@@ -1988,7 +2715,54 @@ pub fn parse(
     let mut pds = pd_flatten(&xml_sdf, root_pds)?;
 
     for node in channel_nodes {
-        let ch = Channel::from_xml(&xml_sdf, &node, &pds)?;
+        let ch = Channel::from_xml(config, &xml_sdf, &node, &pds)?;
+
+        if let Some(coalesce_mr) = &ch.coalesce_mr {
+            let text_pos = xml_sdf.doc.text_pos_at(node.range().start);
+            for end in [&ch.end_a, &ch.end_b] {
+                pds[end.pd].maps.push(SysMap {
+                    mr: coalesce_mr.clone(),
+                    vaddr: end.coalesce_vaddr.unwrap(),
+                    perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+                    cached: true,
+                    text_pos: Some(text_pos),
+                });
+            }
+            mrs.push(SysMemoryRegion::new_tool_created(
+                config,
+                coalesce_mr,
+                config.page_sizes()[0],
+                text_pos,
+            ));
+        }
+
+        if let Some(pp_buffer) = &ch.pp_buffer {
+            let text_pos = xml_sdf.doc.text_pos_at(node.range().start);
+            for end in [&ch.end_a, &ch.end_b] {
+                let pd = &mut pds[end.pd];
+                let vaddr = end.pp_buffer_vaddr.unwrap();
+                pd.maps.push(SysMap {
+                    mr: pp_buffer.mr.clone(),
+                    vaddr,
+                    perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+                    cached: true,
+                    text_pos: Some(text_pos),
+                });
+                if let Some(symbol) = &end.setvar_pp_buffer {
+                    let setvar = SysSetVar {
+                        symbol: symbol.clone(),
+                        kind: SysSetVarKind::Vaddr { address: vaddr },
+                    };
+                    checked_add_setvar(&mut pd.setvars, setvar, &xml_sdf, &node)?;
+                }
+            }
+            mrs.push(SysMemoryRegion::new_tool_created(
+                config,
+                &pp_buffer.mr,
+                pp_buffer.size,
+                text_pos,
+            ));
+        }
 
         if let Some(setvar_id) = &ch.end_a.setvar_id {
             let setvar = SysSetVar {
@@ -2009,6 +2783,71 @@ pub fn parse(
         channels.push(ch);
     }
 
+    for node in ring_nodes {
+        let ring = Ring::from_xml(config, &xml_sdf, &node, &pds)?;
+
+        for end in [&ring.producer, &ring.consumer] {
+            let pd = &mut pds[end.pd];
+            pd.maps.push(SysMap {
+                mr: ring.mr.name.clone(),
+                vaddr: end.vaddr,
+                perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+                cached: true,
+                text_pos: Some(end.text_pos),
+            });
+
+            if let Some(setvar_vaddr) = &end.setvar_vaddr {
+                let setvar = SysSetVar {
+                    symbol: setvar_vaddr.to_string(),
+                    kind: SysSetVarKind::Vaddr { address: end.vaddr },
+                };
+                checked_add_setvar(&mut pd.setvars, setvar, &xml_sdf, &node)?;
+            }
+
+            if let Some(setvar_size) = &end.setvar_size {
+                let setvar = SysSetVar {
+                    symbol: setvar_size.to_string(),
+                    kind: SysSetVarKind::Size {
+                        mr: ring.mr.name.clone(),
+                    },
+                };
+                checked_add_setvar(&mut pd.setvars, setvar, &xml_sdf, &node)?;
+            }
+
+            if let Some(setvar_id) = &end.setvar_id {
+                let setvar = SysSetVar {
+                    symbol: setvar_id.to_string(),
+                    kind: SysSetVarKind::Id { id: end.id },
+                };
+                checked_add_setvar(&mut pd.setvars, setvar, &xml_sdf, &node)?;
+            }
+        }
+
+        if ring.log {
+            let producer = &mut pds[ring.producer.pd];
+            if producer.log_ring.is_some() {
+                return Err(format!(
+                    "Error: protection domain '{}' has more than one log ring: {}",
+                    producer.name,
+                    loc_string(&xml_sdf, xml_sdf.doc.text_pos_at(node.range().start))
+                ));
+            }
+            producer.log_ring = Some(LogRing {
+                vaddr: ring.producer.vaddr,
+                size: ring.mr.size,
+                id: ring.producer.id,
+            });
+        }
+
+        channels.push(Channel {
+            end_a: ring.producer.channel_end(),
+            end_b: ring.consumer.channel_end(),
+            coalesce_mr: None,
+            pp_buffer: None,
+        });
+        mrs.push(ring.mr);
+    }
+
     // FIXME: Now we post-fill the PD ids in the capmap elements, which is
     //        ugly, and we should rework this to be less so.
     let pd_names_to_id: HashMap<_, _> = pds
@@ -2030,6 +2869,162 @@ pub fn parse(
         }
     }
 
+    // Create the channel groups bitmap of each PD that has one and map it into
+    // every PD that notifies one of its channel group IDs.
+    for pd in pds.iter_mut() {
+        let Some(vaddr) = pd.channel_groups_vaddr else {
+            continue;
+        };
+        let text_pos = pd.text_pos.unwrap();
+        let mr = SysMemoryRegion::new_tool_created(
+            config,
+            &format!("channel_groups_{}", pd.name),
+            config.page_sizes()[0],
+            text_pos,
+        );
+        pd.maps.push(SysMap {
+            mr: mr.name.clone(),
+            vaddr,
+            perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+            cached: true,
+            text_pos: Some(text_pos),
+        });
+        mrs.push(mr);
+    }
+    for ch in &channels {
+        for (end, other) in [(&ch.end_a, &ch.end_b), (&ch.end_b, &ch.end_a)] {
+            let Some(group_vaddr) = end.group_vaddr else {
+                continue;
+            };
+            let map = SysMap {
+                mr: format!("channel_groups_{}", pds[other.pd].name),
+                vaddr: group_vaddr,
+                perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+                cached: true,
+                text_pos: pds[end.pd].text_pos,
+            };
+            // A PD with several channels to the same PD only needs the bitmap mapped once.
+            let pd = &mut pds[end.pd];
+            if !pd
+                .maps
+                .iter()
+                .any(|existing| existing.mr == map.mr && existing.vaddr == map.vaddr)
+            {
+                pd.maps.push(map);
+            }
+        }
+    }
+
+    // Create the heap of each PD that has one.
+    for pd in pds.iter_mut() {
+        let Some(heap) = &pd.heap else {
+            continue;
+        };
+        let text_pos = pd.text_pos.unwrap();
+        let mut mr = SysMemoryRegion::new_tool_created(
+            config,
+            &format!("heap_{}", pd.name),
+            heap.size,
+            text_pos,
+        );
+        if let Some(page_size) = heap.page_size {
+            mr.page_size = page_size.into();
+            mr.page_size_specified_by_user = true;
+            mr.page_count = heap.size / page_size;
+        }
+        pd.maps.push(SysMap {
+            mr: mr.name.clone(),
+            vaddr: heap.vaddr,
+            perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+            cached: true,
+            text_pos: Some(text_pos),
+        });
+        mrs.push(mr);
+    }
+
+    // Create the instrumentation regions, which can only be done now that the
+    // observer PDs can be looked up.
+    for pd_idx in 0..pds.len() {
+        let Some(instrumentation) = pds[pd_idx].instrumentation.take() else {
+            continue;
+        };
+
+        let mr = SysMemoryRegion::new_tool_created(
+            config,
+            &format!("instrumentation_{}", pds[pd_idx].name),
+            PD_INSTRUMENTATION_SIZE,
+            instrumentation.text_pos,
+        );
+
+        pds[pd_idx].maps.push(SysMap {
+            mr: mr.name.clone(),
+            vaddr: instrumentation.vaddr,
+            perms: SysMapPerms::Read as u8 | SysMapPerms::Write as u8,
+            cached: true,
+            text_pos: Some(instrumentation.text_pos),
+        });
+
+        if let Some(observer_name) = &instrumentation.observer {
+            let Some(&observer_idx) = pd_names_to_id.get(observer_name) else {
+                return Err(format!(
+                    "Error: unknown PD name '{}': {}",
+                    observer_name,
+                    loc_string(&xml_sdf, instrumentation.text_pos)
+                ));
+            };
+            if observer_idx == pd_idx {
+                return Err(format!(
+                    "Error: protection domain '{}' cannot be its own instrumentation observer: {}",
+                    observer_name,
+                    loc_string(&xml_sdf, instrumentation.text_pos)
+                ));
+            }
+
+            let observer = &mut pds[observer_idx];
+            let observer_vaddr = instrumentation.observer_vaddr.unwrap();
+            let max_vaddr = config.pd_map_max_vaddr(observer.stack_size);
+            if observer_vaddr >= max_vaddr {
+                return Err(format!(
+                    "Error: observer_vaddr (0x{:x}) must be less than 0x{:x}: {}",
+                    observer_vaddr,
+                    max_vaddr,
+                    loc_string(&xml_sdf, instrumentation.text_pos)
+                ));
+            }
+
+            observer.maps.push(SysMap {
+                mr: mr.name.clone(),
+                vaddr: observer_vaddr,
+                perms: SysMapPerms::Read as u8,
+                cached: true,
+                text_pos: Some(instrumentation.text_pos),
+            });
+
+            if let Some(symbol) = &instrumentation.observer_setvar_vaddr {
+                if observer
+                    .setvars
+                    .iter()
+                    .any(|setvar| setvar.symbol == *symbol)
+                {
+                    return Err(format!(
+                        "Error: setvar on symbol '{}' already exists: {}",
+                        symbol,
+                        loc_string(&xml_sdf, instrumentation.text_pos)
+                    ));
+                }
+                observer.setvars.push(SysSetVar {
+                    symbol: symbol.clone(),
+                    kind: SysSetVarKind::Vaddr {
+                        address: observer_vaddr,
+                    },
+                });
+            }
+        }
+
+        mrs.push(mr);
+        pds[pd_idx].instrumentation = Some(instrumentation);
+    }
+
     // Now that we have parsed everything in the system description we can validate any
     // global properties (e.g no duplicate PD names etc).
 
@@ -2111,6 +3106,30 @@ pub fn parse(
         }
     }
 
+    // The badge bit of CHANNEL_GROUP_ID is used for delivering channel groups
+    for (pd_idx, pd) in pds.iter().enumerate() {
+        if pd.channel_groups_vaddr.is_none() {
+            continue;
+        }
+        let irq_ids = pd.irqs.iter().map(|irq| irq.id);
+        let ch_ids = channels.iter().flat_map(|ch| {
+            [&ch.end_a, &ch.end_b]
+                .into_iter()
+                .filter(|end| end.pd == pd_idx)
+                .map(|end| end.id)
+        });
+        if irq_ids.chain(ch_ids).any(|id| id == CHANNEL_GROUP_ID) {
+            return Err(format!(
+                "Error: channel id {} is reserved in protection domain with channel groups: '{}' @ {}:{}:{}",
+                CHANNEL_GROUP_ID,
+                pd.name,
+                filename.display(),
+                pd.text_pos.unwrap().row,
+                pd.text_pos.unwrap().col
+            ));
+        }
+    }
+
     // Ensure no duplicate channel identifiers.
     // This means checking that no interrupt IDs clash with any channel IDs
     let mut ch_ids = vec![vec![]; pds.len()];
@@ -2242,9 +3261,15 @@ pub fn parse(
 
     // Ensure that all maps are correct
     for pd in &pds {
-        check_maps(&xml_sdf, &mrs, pd, &pd.maps)?;
+        check_maps(
+            &xml_sdf,
+            &mrs,
+            pd,
+            &pd.maps,
+            config.pd_map_max_vaddr(pd.stack_size),
+        )?;
         if let Some(vm) = &pd.virtual_machine {
-            check_maps(&xml_sdf, &mrs, vm, &vm.maps)?;
+            check_maps(&xml_sdf, &mrs, vm, &vm.maps, config.vm_map_max_vaddr())?;
         }
     }
 
@@ -366,10 +366,12 @@ impl Config {
 
     /// For simplicity and consistency, the stack & IPC buffers of each PD
     /// occupy the highest memory regions near seL4_UserVSpaceTop.
-    /// So the maximum vaddr allowed for mapping is the stack bottom.
+    /// So the maximum vaddr allowed for mapping is the stack bottom, less a
+    /// guard page so that a stack overflow faults rather than running into
+    /// whatever is mapped below.
     /// Value is exclusive ..max)
     pub fn pd_map_max_vaddr(&self, stack_size: u64) -> u64 {
-        self.pd_stack_bottom(stack_size)
+        self.pd_stack_bottom(stack_size) - PageSize::Small as u64
     }
 
     /// Unlike PDs, virtual machines do not have a stack or IPC buffer and so
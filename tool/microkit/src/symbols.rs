@@ -101,24 +101,56 @@ pub fn patch_symbols(
         elf_obj
             .write_symbol("microkit_passive", &[pd.passive as u8])
             .unwrap();
+        elf_obj
+            .write_symbol("microkit_poll_budget", &pd.poll_budget.to_le_bytes())
+            .unwrap();
+        if let Some(heap) = &pd.heap {
+            elf_obj
+                .write_symbol("microkit_heap_base", &heap.vaddr.to_le_bytes())
+                .unwrap();
+            elf_obj
+                .write_symbol("microkit_heap_size", &heap.size.to_le_bytes())
+                .unwrap();
+        }
 
         let mut notification_bits: u64 = 0;
         let mut pp_bits: u64 = 0;
+        // Notifications sent on channel group IDs of this PD, and for channels where
+        // the other end uses a channel group ID, the address of the other end's
+        // bitmap with the index of the ID in the lower bits.
+        let mut group_notification_bits: Vec<u64> = Vec::new();
+        let mut group_targets: Vec<u64> = Vec::new();
         for channel in system.channels.iter() {
-            if channel.end_a.pd == pd_global_idx {
-                if channel.end_a.notify {
-                    notification_bits |= 1 << channel.end_a.id;
+            for (end, other) in [
+                (&channel.end_a, &channel.end_b),
+                (&channel.end_b, &channel.end_a),
+            ] {
+                if end.pd != pd_global_idx {
+                    continue;
                 }
-                if channel.end_a.pp {
-                    pp_bits |= 1 << channel.end_a.id;
+                if end.is_group_id() {
+                    if end.notify {
+                        let idx = (end.id - sdf::CHANNEL_GROUP_MIN_ID) as usize;
+                        if group_notification_bits.len() <= idx / 64 {
+                            group_notification_bits.resize(idx / 64 + 1, 0);
+                        }
+                        group_notification_bits[idx / 64] |= 1 << (idx % 64);
+                    }
+                    continue;
                 }
-            }
-            if channel.end_b.pd == pd_global_idx {
-                if channel.end_b.notify {
-                    notification_bits |= 1 << channel.end_b.id;
+                if end.notify {
+                    notification_bits |= 1 << end.id;
+                    if other.is_group_id() {
+                        let id = end.id as usize;
+                        if group_targets.len() <= id {
+                            group_targets.resize(id + 1, 0);
+                        }
+                        group_targets[id] =
+                            end.group_vaddr.unwrap() | (other.id - sdf::CHANNEL_GROUP_MIN_ID);
+                    }
                 }
-                if channel.end_b.pp {
-                    pp_bits |= 1 << channel.end_b.id;
+                if end.pp {
+                    pp_bits |= 1 << end.id;
                 }
             }
         }
@@ -135,6 +167,124 @@ pub fn patch_symbols(
             .write_symbol("microkit_ioports", &pd.ioport_bits().to_le_bytes())
             .unwrap();
 
+        // For channels with notification coalescing, each end is told the address of
+        // the shared flags page, with the lowest bit indicating which end it is.
+        let mut coalesce_bits: u64 = 0;
+        let mut coalesce_flags: Vec<u64> = Vec::new();
+        for channel in system.channels.iter() {
+            if channel.coalesce_mr.is_none() {
+                continue;
+            }
+            for (end_idx, end) in [&channel.end_a, &channel.end_b].iter().enumerate() {
+                if end.pd == pd_global_idx {
+                    let id = end.id as usize;
+                    if coalesce_flags.len() <= id {
+                        coalesce_flags.resize(id + 1, 0);
+                    }
+                    coalesce_bits |= 1 << end.id;
+                    coalesce_flags[id] = end.coalesce_vaddr.unwrap() | end_idx as u64;
+                }
+            }
+        }
+        elf_obj
+            .write_symbol("microkit_coalesced", &coalesce_bits.to_le_bytes())
+            .unwrap();
+
+        if coalesce_bits != 0 {
+            let coalesce_flags_bytes: Vec<u8> = coalesce_flags
+                .iter()
+                .flat_map(|vaddr| vaddr.to_le_bytes())
+                .collect();
+            elf_obj
+                .write_symbol("microkit_coalesce_flags", &coalesce_flags_bytes)
+                .unwrap();
+        }
+
+        // Channels with a PPC buffer are told its address and size at both ends.
+        let mut pp_buffers: Vec<u64> = Vec::new();
+        let mut pp_buffer_sizes: Vec<u64> = Vec::new();
+        for channel in system.channels.iter() {
+            let Some(pp_buffer) = &channel.pp_buffer else {
+                continue;
+            };
+            for end in [&channel.end_a, &channel.end_b] {
+                if end.pd == pd_global_idx {
+                    let id = end.id as usize;
+                    if pp_buffers.len() <= id {
+                        pp_buffers.resize(id + 1, 0);
+                        pp_buffer_sizes.resize(id + 1, 0);
+                    }
+                    pp_buffers[id] = end.pp_buffer_vaddr.unwrap();
+                    pp_buffer_sizes[id] = pp_buffer.size;
+                }
+            }
+        }
+        if !pp_buffers.is_empty() {
+            let pp_buffers_bytes: Vec<u8> = pp_buffers
+                .iter()
+                .flat_map(|vaddr| vaddr.to_le_bytes())
+                .collect();
+            let pp_buffer_sizes_bytes: Vec<u8> = pp_buffer_sizes
+                .iter()
+                .flat_map(|size| size.to_le_bytes())
+                .collect();
+            elf_obj
+                .write_symbol("microkit_pp_buffers", &pp_buffers_bytes)
+                .unwrap();
+            elf_obj
+                .write_symbol("microkit_pp_buffer_sizes", &pp_buffer_sizes_bytes)
+                .unwrap();
+        }
+
+        elf_obj
+            .write_symbol(
+                "microkit_channel_groups",
+                &pd.channel_groups_vaddr.unwrap_or(0).to_le_bytes(),
+            )
+            .unwrap();
+        if !group_notification_bits.is_empty() {
+            let group_notification_bytes: Vec<u8> = group_notification_bits
+                .iter()
+                .flat_map(|bits| bits.to_le_bytes())
+                .collect();
+            elf_obj
+                .write_symbol("microkit_group_notifications", &group_notification_bytes)
+                .unwrap();
+        }
+        if !group_targets.is_empty() {
+            let group_targets_bytes: Vec<u8> = group_targets
+                .iter()
+                .flat_map(|target| target.to_le_bytes())
+                .collect();
+            elf_obj
+                .write_symbol("microkit_group_targets", &group_targets_bytes)
+                .unwrap();
+        }
+
+        if let Some(log_ring) = &pd.log_ring {
+            elf_obj
+                .write_symbol("microkit_log_ring", &log_ring.vaddr.to_le_bytes())
+                .unwrap();
+            elf_obj
+                .write_symbol("microkit_log_ring_size", &log_ring.size.to_le_bytes())
+                .unwrap();
+            elf_obj
+                .write_symbol("microkit_log_ch", &log_ring.id.to_le_bytes())
+                .unwrap();
+        }
+
+        let instrumentation_vaddr = pd
+            .instrumentation
+            .as_ref()
+            .map(|instrumentation| instrumentation.vaddr)
+            .unwrap_or(0);
+        elf_obj
+            .write_symbol(
+                "microkit_instrumentation",
+                &instrumentation_vaddr.to_le_bytes(),
+            )
+            .unwrap();
+
         let mut symbols_to_write: Vec<(&String, u64)> = Vec::new();
         for setvar in pd.setvars.iter() {
             // Check that the symbol exists in the ELF
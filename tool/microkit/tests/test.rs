@@ -381,6 +381,32 @@ mod protection_domain {
         )
     }
 
+    #[test]
+    fn test_program_image_invalid_large_pages() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_program_image_invalid_large_pages.system",
+            "Error: large_pages must be 'true' or 'false' on element 'program_image': ",
+        )
+    }
+
+    #[test]
+    fn test_program_image_share_readonly() {
+        check_success(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_program_image_share_readonly.system",
+        )
+    }
+
+    #[test]
+    fn test_program_image_invalid_share_readonly() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_program_image_invalid_share_readonly.system",
+            "Error: share_readonly must be 'true' or 'false' on element 'program_image': ",
+        )
+    }
+
     #[test]
     fn test_budget_gt_period() {
         check_error(&DEFAULT_AARCH64_KERNEL_CONFIG, "pd_budget_gt_period.system", "Error: budget (1000) must be less than, or equal to, period (100) on element 'protection_domain':")
@@ -693,6 +719,81 @@ mod protection_domain {
             "Error: cpu core must be less than 1, got 10 on element 'protection_domain':",
         )
     }
+
+    #[test]
+    fn test_poll_budget_valid() {
+        check_success(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_poll_budget_valid.system",
+        )
+    }
+
+    #[test]
+    fn test_poll_budget_passive() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_poll_budget_passive.system",
+            "Error: poll_budget cannot be used with passive protection domains on element 'protection_domain':",
+        )
+    }
+
+    #[test]
+    fn test_heap_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "pd_heap_valid.system")
+    }
+
+    #[test]
+    fn test_heap_size_not_multiple_of_page_size() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_heap_size_not_multiple_of_page_size.system",
+            "Error: size is not a multiple of the page size on element 'heap':",
+        )
+    }
+
+    #[test]
+    fn test_heap_invalid_page_size() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_heap_invalid_page_size.system",
+            "Error: page size 0x3000 not supported on element 'heap':",
+        )
+    }
+
+    #[test]
+    fn test_instrumentation_valid() {
+        check_success(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_instrumentation_valid.system",
+        )
+    }
+
+    #[test]
+    fn test_instrumentation_unknown_observer() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_instrumentation_unknown_observer.system",
+            "Error: unknown PD name 'invalid': pd_instrumentation_unknown_observer.system:10:9",
+        )
+    }
+
+    #[test]
+    fn test_instrumentation_self_observer() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_instrumentation_self_observer.system",
+            "Error: protection domain 'test1' cannot be its own instrumentation observer: pd_instrumentation_self_observer.system:10:9",
+        )
+    }
+
+    #[test]
+    fn test_instrumentation_missing_observer_vaddr() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "pd_instrumentation_missing_observer_vaddr.system",
+            "Error: observer and observer_vaddr must be specified together on element 'instrumentation':",
+        )
+    }
 }
 
 #[cfg(test)]
@@ -899,6 +1000,138 @@ mod channel {
         )
     }
 
+    #[test]
+    fn test_coalesce_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "ch_coalesce_valid.system")
+    }
+
+    #[test]
+    fn test_coalesce_invalid() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_coalesce_invalid.system",
+            "Error: coalesce must be 'true' or 'false' on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_coalesce_missing_vaddr() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_coalesce_missing_vaddr.system",
+            "Error: coalesce_vaddr must be specified on both ends when coalesce is 'true' on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_coalesce_vaddr_without_coalesce() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_coalesce_vaddr_without_coalesce.system",
+            "Error: coalesce_vaddr must only be specified when coalesce is 'true' on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_pp_buffer_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "ch_pp_buffer_valid.system")
+    }
+
+    #[test]
+    fn test_pp_buffer_not_pp() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_pp_buffer_not_pp.system",
+            "Error: pp_buffer_size can only be used on channels with pp on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_pp_buffer_missing_vaddr() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_pp_buffer_missing_vaddr.system",
+            "Error: pp_buffer_vaddr must be specified on both ends when pp_buffer_size is specified on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_pp_buffer_vaddr_without_size() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_pp_buffer_vaddr_without_size.system",
+            "Error: pp_buffer_vaddr must only be specified when pp_buffer_size is specified on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_pp_buffer_size_not_multiple_of_page_size() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_pp_buffer_size_not_multiple_of_page_size.system",
+            "Error: pp_buffer_size must be a non-zero multiple of the page size on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_group_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "ch_group_valid.system")
+    }
+
+    #[test]
+    fn test_group_id_without_groups() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_id_without_groups.system",
+            "Error: id must be < 62 on element 'end': ",
+        )
+    }
+
+    #[test]
+    fn test_group_id_out_of_range() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_id_out_of_range.system",
+            "Error: id must be < 62, or between 64 and 1087 for channel groups on element 'end': ",
+        )
+    }
+
+    #[test]
+    fn test_group_missing_vaddr() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_missing_vaddr.system",
+            "Error: group_vaddr must be specified on ends that notify a channel group id on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_group_vaddr_without_group_id() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_vaddr_without_group_id.system",
+            "Error: group_vaddr must only be specified on ends that notify a channel group id on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_group_pp() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_pp.system",
+            "Error: channel group ids cannot be used on channels with pp on element 'channel': ",
+        )
+    }
+
+    #[test]
+    fn test_group_reserved_id() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ch_group_reserved_id.system",
+            "Error: channel id 61 is reserved in protection domain with channel groups: 'mux'",
+        )
+    }
+
     #[test]
     fn test_ppcall_priority() {
         check_error(&DEFAULT_AARCH64_KERNEL_CONFIG,
@@ -908,6 +1141,66 @@ mod channel {
     }
 }
 
+#[cfg(test)]
+mod ring {
+    use super::*;
+
+    #[test]
+    fn test_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "ring_valid.system")
+    }
+
+    #[test]
+    fn test_missing_consumer() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ring_missing_consumer.system",
+            "Error: exactly one producer and one consumer must be specified on element 'ring': ",
+        )
+    }
+
+    #[test]
+    fn test_same_pd() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ring_same_pd.system",
+            "Error: producer and consumer must be different protection domains on element 'ring': ",
+        )
+    }
+
+    #[test]
+    fn test_size_not_multiple_of_page_size() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ring_size_not_multiple_of_page_size.system",
+            "Error: size is not a multiple of the page size on element 'ring': ",
+        )
+    }
+
+    #[test]
+    fn test_duplicate_channel_id() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ring_duplicate_channel_id.system",
+            "Error: duplicate channel id: 0 in protection domain: 'test1' @",
+        )
+    }
+
+    #[test]
+    fn test_log_valid() {
+        check_success(&DEFAULT_AARCH64_KERNEL_CONFIG, "ring_log_valid.system")
+    }
+
+    #[test]
+    fn test_log_duplicate() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "ring_log_duplicate.system",
+            "Error: protection domain 'test1' has more than one log ring: ",
+        )
+    }
+}
+
 #[cfg(test)]
 mod system {
     use super::*;
@@ -1007,7 +1300,16 @@ mod system {
         check_error(
             &DEFAULT_AARCH64_KERNEL_CONFIG,
             "sys_map_too_high.system",
-            "Error: vaddr (0x1000000000000000) must be less than 0xffffffc000 on element 'map'",
+            "Error: vaddr (0x1000000000000000) must be less than 0xffffffb000 on element 'map'",
+        )
+    }
+
+    #[test]
+    fn test_map_into_stack_guard() {
+        check_error(
+            &DEFAULT_AARCH64_KERNEL_CONFIG,
+            "sys_map_into_stack_guard.system",
+            "Error: map for 'foo' has virtual address range [0xffffffa000..0xffffffc000) which extends past 0xffffffb000 in protection domain 'test1' @ ",
         )
     }
 